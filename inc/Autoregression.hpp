@@ -55,17 +55,17 @@ static int autoregression_seed = 334340;
  * @param coefficient		parameters of the autoregressive model phi[i], phi[2], phi[3], ...
  * @param variance			(optional) an AR progress has white noise with variance \sigma^2.
  * @param constant			(optional) a constant as in the definition
+ * @param random_number_generator	the generator for the white noise
  * @return 					next value x[t]
  */
 template<typename InputIterator1, typename InputIterator2, typename T>
 inline T predict(InputIterator1 first1, InputIterator1 last1,
-		InputIterator2 first2, T constant, T variance = T(1)) {
+		InputIterator2 first2, T constant, T variance, boost::mt19937 & random_number_generator) {
 	__glibcxx_function_requires(_InputIteratorConcept<InputIterator1>);
 	__glibcxx_function_requires(_InputIteratorConcept<InputIterator2>);
 	__glibcxx_requires_valid_range(first1, last1);
 
 	//	assert (container.size() == coefficients.size());
-	static boost::mt19937 random_number_generator(autoregression_seed);
 	boost::normal_distribution<> normal_dist(0.0, variance);
 	boost::variate_generator<boost::mt19937&, boost::normal_distribution<> > epsilon(
 			random_number_generator, normal_dist);
@@ -78,6 +78,17 @@ inline T predict(InputIterator1 first1, InputIterator1 last1,
 	return prediction;
 }
 
+/**
+ * The same prediction, but with one generator for the white noise that is shared by everybody.
+ * This is not safe if multiple threads (for example several filters) call it at the same time.
+ */
+template<typename InputIterator1, typename InputIterator2, typename T>
+inline T predict(InputIterator1 first1, InputIterator1 last1,
+		InputIterator2 first2, T constant, T variance = T(1)) {
+	static boost::mt19937 random_number_generator(autoregression_seed);
+	return predict(first1, last1, first2, constant, variance, random_number_generator);
+}
+
 /**
  * A vector is not the best format to implement a circular buffer. However, sometimes a
  * vector is required for other purposes and then an "advance" method is interesting, it
@@ -0,0 +1,121 @@
+/**
+ * @brief Weights per pixel for how much they look like the tracked object
+ * @file BackProjection.h
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 18, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+
+#ifndef BACKPROJECTION_H_
+#define BACKPROJECTION_H_
+
+// General files
+#include <Histogram.h>
+
+#include <vector>
+
+/* **************************************************************************************
+ * Interface of BackProjection
+ * **************************************************************************************/
+
+/**
+ * The back-projection of a histogram on an image replaces every pixel by the weight of its bin. The
+ * weights are those of the ratio histogram (Swain and Ballard): the histogram of the object divided
+ * by the histogram of the whole image, scaled to at most one. Colours that are common in the
+ * object, but rare elsewhere in the image, get a high weight.
+ *
+ * Mean-shift moves a rectangle to the centroid of the weights within it, until it does not move
+ * anymore. This climbs to a local maximum of the density of object colours, as in the "Mean Shift
+ * Embedded Particle Filter" (Shan, Tan, Wei).
+ *
+ * The bins are the same as those of a Histogram in HM_GLOBAL mode with the same bins, channels and
+ * channel mode. With concatenated channels the weight of a pixel is the average over its channels,
+ * looked up per channel in a table of 256 values. With joint channels the tables give the part of
+ * the bin index per channel (as for the histograms) and the weight is looked up once per pixel.
+ *
+ * The weights are summed in summed-area tables, also multiplied by x and y. The sum of the weights
+ * in any rectangle, and with that a mean-shift step, then takes four lookups per table.
+ *
+ * Usage:
+ *   calcBackProjection (for every frame), getSum or meanShift (for every rectangle)
+ */
+class BackProjection: public ProbMatrix {
+public:
+	//! Constructor with the number of bins (per channel) and the channels to use
+	BackProjection(int bins, int channels = 1, ChannelMode channel_mode = CM_JOINT);
+
+	//! Destructor ~BackProjection
+	virtual ~BackProjection();
+
+	/**
+	 * Calculate the weights of all pixels of an image, with its channels as planes one after another
+	 * (the CImg layout). If the image has less channels than configured, only those are used.
+	 * @param target		normalized histogram of the object, with the configuration of this object
+	 * @param data			the pixel values
+	 * @param width			width of the image
+	 * @param height		height of the image
+	 * @param spectrum		number of channels (planes) in the data
+	 */
+	void calcBackProjection(const NormalizedHistogramValues & target, pDataMatrix data, int width,
+			int height, int spectrum = 1);
+
+	/**
+	 * Move a rectangle with the given centre and size to the centroid of the weights within it, at
+	 * most a number of times, or until it moves less than epsilon. The part of the rectangle outside
+	 * of the image is ignored. If there is no weight at all, the rectangle does not move.
+	 * @return				the number of iterations
+	 */
+	int meanShift(float & x, float & y, float width, float height, int iterations, float epsilon = 0.5) const;
+
+	/**
+	 * The sum of the weights of the rectangle [x0,x1]x[y0,y1] (inclusive, like CImg::get_crop). The
+	 * part of the rectangle outside of the image is ignored.
+	 */
+	inline double getSum(int x0, int y0, int x1, int y1) const { return getSum(sum, x0, y0, x1, y1); }
+
+	//! Weight of a pixel, in [0,1]
+	inline float getWeight(int x, int y) const { return weights[y * p_width + x]; }
+
+	//! Width of the image of the last calcBackProjection
+	inline int getWidth() const { return p_width; }
+
+	//! Height of the image of the last calcBackProjection
+	inline int getHeight() const { return p_height; }
+
+private:
+	//! Number of channels asked for in the constructor (images can have less)
+	int configured_channels;
+
+	//! The weight per pixel, row after row
+	std::vector<float> weights;
+
+	//! The weight per bin
+	std::vector<float> ratio;
+
+	//! Weight per channel and 8-bit value (channel*256+value), for concatenated channels
+	std::vector<float> lut;
+
+	//! Summed-area tables of the weights, and of the weights times x and times y, (width+1)*(height+1)
+	std::vector<double> sum, sum_x, sum_y;
+
+	//! The sum of a rectangle in one of the summed-area tables
+	double getSum(const std::vector<double> & table, int x0, int y0, int x1, int y1) const;
+};
+
+#endif /* BACKPROJECTION_H_ */
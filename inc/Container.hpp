@@ -34,6 +34,8 @@
 #include <iostream>
 #include <cmath>
 #include <iterator>
+#include <limits>
+#include <complex>
 
 /****************************************************************************************************
  * Helper functions for containers.
@@ -447,6 +449,223 @@ struct comp_point_distance: public std::binary_function<Point, Point, bool> {
 	PointIterator last_ref;
 };
 
+/**
+ * Sets with at least this number of points get a k-d tree in distance_to_set, below it a linear scan
+ * over the set is faster than building the tree.
+ */
+#ifndef KDTREE_MIN_SET_SIZE
+#define KDTREE_MIN_SET_SIZE		64
+#endif
+
+/**
+ * Compare the indices of two points in a flat array of coordinates on one of their coordinates. It
+ * is used to split the points in a k-d tree.
+ */
+template<typename T>
+struct comp_coordinate: public std::binary_function<int, int, bool> {
+	comp_coordinate(const std::vector<T> & data, int dim, int split_dim):
+		data(data), dim(dim), split_dim(split_dim) {
+	}
+	bool operator()(int x, int y) const {
+		return data[x*dim+split_dim] < data[y*dim+split_dim];
+	}
+	const std::vector<T> & data;
+	int dim;
+	int split_dim;
+};
+
+/**
+ * A k-d tree over a set of points to find the distance of a point to the nearest point in the set
+ * in about logarithmic instead of linear time. The coordinates are copied into the tree, so the
+ * set can be changed afterwards (but the tree will not follow).
+ *
+ * Each node splits its points on the coordinate with the largest spread at the median. A query
+ * visits the side of the query point first and only visits the other side if the distance to the
+ * splitting plane is smaller than the best distance so far. This only works for metrics for which
+ * the difference in one coordinate is a lower bound on the distance, see supports().
+ *
+ * The queries can be approximate with epsilon > 0: the distance returned is then at most (1+epsilon)
+ * times the distance to the nearest point, which prunes a lot more of the tree.
+ *
+ * Usage:
+ *   KdTree<double> tree(DM_EUCLIDEAN); tree.build(set.begin(), set.end());
+ *   double d = tree.nearest(point->begin(), point->end());
+ */
+template<typename T>
+class KdTree {
+public:
+	/**
+	 * @param metric			the distance metric between points
+	 * @param leaf_size			nodes with this number of points or less are not split
+	 */
+	KdTree(DistanceMetric metric = DM_EUCLIDEAN, int leaf_size = 8): metric(metric), leaf_size(leaf_size),
+		dim(0) {
+		assert (supports(metric));
+		assert (leaf_size > 0);
+	}
+
+	//! The metrics that can be used in the tree
+	static bool supports(DistanceMetric metric) {
+		return (metric == DM_EUCLIDEAN) || (metric == DM_MANHATTAN) || (metric == DM_CHEBYSHEV);
+	}
+
+	/**
+	 * Build the tree over a set of points, for example a std::set<std::vector<double>*>. All points
+	 * should have the same number of coordinates.
+	 */
+	template<typename SetIterator>
+	void build(SetIterator first, SetIterator last) {
+		data.clear();
+		index.clear();
+		nodes.clear();
+		dim = 0;
+		if (first == last) return;
+		dim = std::distance((*first)->begin(), (*first)->end());
+		for (; first != last; ++first) {
+			assert (std::distance((*first)->begin(), (*first)->end()) == dim);
+			data.insert(data.end(), (*first)->begin(), (*first)->end());
+		}
+		int count = (dim == 0) ? 1 : data.size() / dim;
+		index.resize(count);
+		for (int i = 0; i < count; ++i) index[i] = i;
+		buildNode(0, count);
+	}
+
+	//! Number of points in the tree
+	inline size_t size() const { return index.size(); }
+
+	/**
+	 * Distance from a point to the nearest point in the tree.
+	 * @param first				start of the point
+	 * @param last				end of the point
+	 * @param epsilon			allowed relative error, 0 for the exact distance
+	 * @param stop				stop searching as soon as a point at this distance or closer has
+	 * 							been found, the result is then only known to be at most stop
+	 * @return					the distance, or -1 if the tree is empty
+	 */
+	template<typename PointIterator>
+	T nearest(PointIterator first, PointIterator last, T epsilon = T(0), T stop = T(-1)) const {
+		if (nodes.empty()) return T(-1);
+		assert (std::distance(first, last) == dim);
+		std::vector<T> query(first, last);
+		T factor = (T(1) + epsilon);
+		T reduced_stop = stop;
+		if (metric == DM_EUCLIDEAN) {
+			factor = factor * factor;
+			if (stop > T(0)) reduced_stop = stop * stop;
+		}
+		T best = std::numeric_limits<T>::max();
+		search(0, query, factor, reduced_stop, best);
+		return (metric == DM_EUCLIDEAN) ? std::sqrt(best) : best;
+	}
+
+protected:
+	/**
+	 * A node covers the points index[begin] till index[end]. If it is not a leaf, the points of the
+	 * left child have coordinate split_dim at most split_value, those of the right child at least.
+	 */
+	struct Node {
+		int begin, end;
+		int split_dim;
+		T split_value;
+		int left, right;
+	};
+
+	//! Create the node over index[begin,end) and its children, returns its position in nodes
+	int buildNode(int begin, int end) {
+		int n = nodes.size();
+		Node node;
+		node.begin = begin; node.end = end;
+		node.split_dim = -1; node.split_value = T(0);
+		node.left = node.right = -1;
+		nodes.push_back(node);
+		if (end - begin <= leaf_size) return n;
+
+		T max_spread = T(0);
+		for (int d = 0; d < dim; ++d) {
+			T lo = data[index[begin]*dim+d], hi = lo;
+			for (int i = begin + 1; i < end; ++i) {
+				T v = data[index[i]*dim+d];
+				if (v < lo) lo = v;
+				if (v > hi) hi = v;
+			}
+			if (hi - lo > max_spread) {
+				max_spread = hi - lo;
+				nodes[n].split_dim = d;
+			}
+		}
+		if (nodes[n].split_dim < 0) return n; // all points equal
+
+		int mid = (begin + end) / 2;
+		std::nth_element(index.begin() + begin, index.begin() + mid, index.begin() + end,
+				comp_coordinate<T>(data, dim, nodes[n].split_dim));
+		nodes[n].split_value = data[index[mid]*dim+nodes[n].split_dim];
+		int left = buildNode(begin, mid);
+		int right = buildNode(mid, end);
+		nodes[n].left = left;
+		nodes[n].right = right;
+		return n;
+	}
+
+	/**
+	 * Distance in the internal representation, which is the squared distance for Euclidean (no square
+	 * roots needed for comparisons). Returns as soon as the distance exceeds bound.
+	 */
+	T reduced_distance(const std::vector<T> & query, int point, T bound) const {
+		const T *p = &data[point*dim];
+		T result = T(0);
+		for (int d = 0; d < dim; ++d) {
+			T diff = query[d] - p[d];
+			switch (metric) {
+			case DM_EUCLIDEAN: result += diff * diff; break;
+			case DM_MANHATTAN: result += std::abs(diff); break;
+			default: result = std::max(result, std::abs(diff)); break;
+			}
+			if (result > bound) break;
+		}
+		return result;
+	}
+
+	//! Depth-first search that keeps the best (reduced) distance so far
+	void search(int n, const std::vector<T> & query, T factor, T stop, T & best) const {
+		const Node & node = nodes[n];
+		if (node.left < 0) {
+			for (int i = node.begin; i < node.end; ++i) {
+				T dist = reduced_distance(query, index[i], best);
+				if (dist < best) best = dist;
+			}
+			return;
+		}
+		T diff = query[node.split_dim] - node.split_value;
+		int near = (diff < T(0)) ? node.left : node.right;
+		int far = (diff < T(0)) ? node.right : node.left;
+		search(near, query, factor, stop, best);
+		if (best <= stop) return;
+		T bound = (metric == DM_EUCLIDEAN) ? diff * diff : std::abs(diff);
+		if (bound * factor < best)
+			search(far, query, factor, stop, best);
+	}
+
+private:
+	//! Metric between points
+	DistanceMetric metric;
+
+	//! Maximum number of points in a leaf
+	int leaf_size;
+
+	//! Number of coordinates per point
+	int dim;
+
+	//! Coordinates of all points, point after point
+	std::vector<T> data;
+
+	//! Permutation of the points, each node covers a consecutive range
+	std::vector<int> index;
+
+	//! All nodes, the root is the first one
+	std::vector<Node> nodes;
+};
+
 /*
  * A function calculating the distance of a point to a set.
  * 	SDM_INFIMIM		the minimum distance to this point, for Euclidean/Manhattan in 1D example, d(1,[3,6]) = 2 and d(7,[3,6]) = 1.
@@ -460,20 +679,21 @@ T distance_to_point(SetIterator first_set, SetIterator last_set, PointIterator f
 	__glibcxx_function_requires(_InputIteratorConcept<PointIterator>);
 	__glibcxx_requires_valid_range(first1, last1);
 	__glibcxx_requires_valid_range(first2, last2);
-	typedef typename std::iterator_traits<SetIterator>::value_type PointType; // e.g. std::vector<double>*
 	typedef typename std::iterator_traits<PointIterator>::value_type PointValueType; // e.g. double
 
+	// calculate every distance only once, instead of twice per comparison as min_element with
+	// comp_point_distance would do
 	T result = T(-1);
-	PointType tmp;
 	switch(set_metric) {
 	case SDM_INFIMIM: // the smallest distance between the point and any point in the set
-		tmp = *std::min_element(first_set, last_set, comp_point_distance<PointType, PointIterator, PointValueType>(
-				point_metric, first_point, last_point));
-		return distance<PointValueType, PointIterator, PointIterator>(tmp->begin(), tmp->end(), first_point, last_point, point_metric);
 	case SDM_SUPREMUM: // the largest distance between the point and any point in the set
-		tmp = *std::max_element(first_set, last_set, comp_point_distance<PointType, PointIterator, PointValueType>(
-				point_metric, first_point, last_point));
-		return distance<PointValueType, PointIterator, PointIterator>(tmp->begin(), tmp->end(), first_point, last_point, point_metric);
+		for (; first_set != last_set; ++first_set) {
+			T dist = distance<PointValueType, PointIterator, PointIterator>((*first_set)->begin(), (*first_set)->end(),
+					first_point, last_point, point_metric);
+			if ((result < T(0)) || ((set_metric == SDM_INFIMIM) ? (dist < result) : (dist > result)))
+				result = dist;
+		}
+		break;
 	default:
 		std::cerr << "Not yet implemented" << std::endl;
 		break;
@@ -533,37 +753,53 @@ struct comp_point_set_distance: public std::binary_function<Point, Point, bool>
  * iterators. All of these iterators should be of the same type SetIterator. However, they should be decomposable into PointIterators.
  * In other words, the set entities should have the PointIterator as valid iterator defined over each of their elements. This definitely
  * requires you to define the template variables (because they cannot be retrieved from the arguments).
+ *
+ * If the second set has at least KDTREE_MIN_SET_SIZE points and the point metric is supported by the
+ * KdTree, a tree is built over it, so the supremum-infimum takes O(|A| log |B|) instead of O(|A| |B|).
+ * With epsilon > 0 the nearest points are searched approximately, the result is then at most a factor
+ * (1+epsilon) too large (an approximate nearest point is never closer than the exact one). Without a
+ * tree the result is always exact.
  */
 template<typename T, typename SetIterator, typename PointIterator>
 T distance_to_set(SetIterator first1, SetIterator last1, SetIterator first2, SetIterator last2,
-		SetDistanceMetric set_metric, DistanceMetric point_metric) {
+		SetDistanceMetric set_metric, DistanceMetric point_metric, T epsilon = T(0)) {
 	__glibcxx_function_requires(_InputIteratorConcept<SetIterator>);
 	__glibcxx_function_requires(_InputIteratorConcept<PointIterator>);
 	__glibcxx_requires_valid_range(first1, last1);
 	__glibcxx_requires_valid_range(first2, last2);
-	typedef typename std::iterator_traits<SetIterator>::value_type PointType; // e.g. std::vector<double>*
 	typedef typename std::iterator_traits<PointIterator>::value_type PointValueType; // e.g. double
 
-	SetDistanceMetric overwrite_set_metric;
-	PointType tmp;
+	T result = T(-1);
 	switch(set_metric) {
 	case SDM_HAUSDORFF: {
-		T dist_xy = distance_to_set<T,SetIterator,PointIterator>(first1, last1, first2, last2, SDM_SUPINF, point_metric);
-		T dist_yx = distance_to_set<T,SetIterator,PointIterator>(first2, last2, first1, last1, SDM_SUPINF, point_metric);
+		T dist_xy = distance_to_set<T,SetIterator,PointIterator>(first1, last1, first2, last2, SDM_SUPINF, point_metric, epsilon);
+		T dist_yx = distance_to_set<T,SetIterator,PointIterator>(first2, last2, first1, last1, SDM_SUPINF, point_metric, epsilon);
 		return std::max(dist_xy, dist_yx);
 	}
 	case SDM_SUPINF:
-		overwrite_set_metric = SDM_INFIMIM;
-		tmp = *std::max_element(first1, last1,
-				comp_point_set_distance<PointType, SetIterator, PointIterator, PointValueType>(
-						overwrite_set_metric, point_metric, first2, last2));
-		return distance_to_point<PointValueType, SetIterator, PointIterator>(
-				first2, last2, tmp->begin(), tmp->end(), overwrite_set_metric, point_metric);
-		break;
+		if (KdTree<PointValueType>::supports(point_metric) &&
+				(std::distance(first2, last2) >= KDTREE_MIN_SET_SIZE)) {
+			KdTree<PointValueType> tree(point_metric);
+			tree.build(first2, last2);
+			// a point that has a neighbour closer than the current maximum does not matter, so the
+			// search for it can stop right away
+			for (; first1 != last1; ++first1) {
+				T dist = tree.nearest((*first1)->begin(), (*first1)->end(), epsilon, std::max(result, T(0)));
+				if (dist > result) result = dist;
+			}
+			return result;
+		}
+		for (; first1 != last1; ++first1) {
+			T dist = distance_to_point<T, SetIterator, PointIterator>(
+					first2, last2, (*first1)->begin(), (*first1)->end(), SDM_INFIMIM, point_metric);
+			if (dist > result) result = dist;
+		}
+		return result;
 	default:
 		std::cerr << "Not yet implemented" << std::endl;
 		break;
 	}
+	return result;
 }
 
 /**
@@ -725,6 +961,171 @@ argmin(ForwardIterator first, ForwardIterator last, UnaryOperation unary_op) {
 	return result;
 }
 
+/**
+ * Containers with at least this number of elements are convolved using the fast Fourier transform,
+ * below it the direct calculation is faster.
+ */
+#ifndef CONVOLUTION_FFT_MIN_SIZE
+#define CONVOLUTION_FFT_MIN_SIZE	128
+#endif
+
+/**
+ * In-place fast Fourier transform of a container whose size is a power of two, iterative radix-2
+ * with bit-reversed ordering first. Forward only and not scaled.
+ */
+template<typename T>
+void fft_radix2(std::vector<std::complex<T> > & data) {
+	size_t n = data.size();
+	for (size_t i = 1, j = 0; i < n; ++i) {
+		size_t bit = n >> 1;
+		for (; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j) std::swap(data[i], data[j]);
+	}
+	// the twiddle factors for the largest butterflies, the smaller ones use every so many of them
+	std::vector<std::complex<T> > twiddle(n / 2);
+	for (size_t k = 0; k < n / 2; ++k)
+		twiddle[k] = std::polar(T(1), T(-2 * M_PI * k / n));
+	for (size_t len = 2; len <= n; len <<= 1) {
+		size_t step = n / len;
+		for (size_t i = 0; i < n; i += len) {
+			for (size_t k = 0; k < len / 2; ++k) {
+				std::complex<T> u = data[i+k];
+				std::complex<T> v = data[i+k+len/2] * twiddle[k*step];
+				data[i+k] = u + v;
+				data[i+k+len/2] = u - v;
+			}
+		}
+	}
+}
+
+/**
+ * Fast Fourier transform of a container of arbitrary size, forward only and not scaled. The
+ * transform is written as a convolution with a chirp (Bluestein's algorithm) which is calculated
+ * with power of two transforms.
+ */
+template<typename T>
+void fft_bluestein(std::vector<std::complex<T> > & data) {
+	size_t n = data.size();
+	size_t m = 1;
+	while (m < 2 * n - 1) m <<= 1;
+	// chirp w_k = exp(-i pi k^2 / n), k^2 modulo 2n keeps the angle accurate
+	std::vector<std::complex<T> > chirp(n);
+	for (size_t k = 0; k < n; ++k) {
+		unsigned long long k2 = ((unsigned long long)k * k) % (2 * n);
+		chirp[k] = std::polar(T(1), T(-M_PI * k2 / n));
+	}
+	std::vector<std::complex<T> > a(m), b(m);
+	for (size_t k = 0; k < n; ++k)
+		a[k] = data[k] * chirp[k];
+	b[0] = std::conj(chirp[0]);
+	for (size_t k = 1; k < n; ++k)
+		b[k] = b[m-k] = std::conj(chirp[k]);
+	fft_radix2(a);
+	fft_radix2(b);
+	for (size_t k = 0; k < m; ++k)
+		a[k] = std::conj(a[k] * b[k]);
+	// inverse by conjugation
+	fft_radix2(a);
+	for (size_t k = 0; k < n; ++k)
+		data[k] = std::conj(a[k]) * chirp[k] / T(m);
+}
+
+/**
+ * The discrete Fourier transform in O(n log n) for any size of container. The inverse transform
+ * is scaled with 1/n, so that fft(data) followed by fft(data, true) returns the original data.
+ * @param data				the sequence to transform, in place
+ * @param inverse			do the inverse transform
+ */
+template<typename T>
+void fft(std::vector<std::complex<T> > & data, bool inverse = false) {
+	size_t n = data.size();
+	if (n <= 1) return;
+	if (inverse) {
+		for (size_t k = 0; k < n; ++k) data[k] = std::conj(data[k]);
+	}
+	if ((n & (n - 1)) == 0)
+		fft_radix2(data);
+	else
+		fft_bluestein(data);
+	if (inverse) {
+		for (size_t k = 0; k < n; ++k) data[k] = std::conj(data[k]) / T(n);
+	}
+}
+
+/**
+ * Convert a real number to the given type, rounding to the nearest integer if it is an integer type.
+ * This is used to get exactly the same results as the direct calculation from the fast Fourier transform.
+ */
+template<typename T>
+inline T round_to(double value) {
+	return std::numeric_limits<T>::is_integer ? T(std::floor(value + 0.5)) : T(value);
+}
+
+/**
+ * The same circular convolution as below, but the second container is not rotated, so its content can
+ * be constant and it is not changed, not even temporarily. For containers of at least
+ * CONVOLUTION_FFT_MIN_SIZE elements it uses the fast Fourier transform, so it takes O(n log n) rather
+ * than O(n^2) time. The containers are copied, so input iterators suffice. They should be of equal size.
+ */
+template<typename InputIterator1, typename InputIterator2, typename OutputIterator>
+OutputIterator circular_convolution_copy(InputIterator1 first1, InputIterator1 last1, InputIterator2 first2,
+		InputIterator2 last2, OutputIterator result, int shift = 1) {
+	__glibcxx_function_requires(_InputIteratorConcept<InputIterator1>);
+	__glibcxx_function_requires(_InputIteratorConcept<InputIterator2>);
+	__glibcxx_requires_valid_range(first1, last1);
+	__glibcxx_requires_valid_range(first2, last2);
+
+	typedef typename std::iterator_traits<InputIterator1>::value_type ValueType1;
+
+	std::vector<ValueType1> a(first1, last1);
+	std::vector<ValueType1> b(first2, last2);
+	long n = a.size();
+	assert (b.size() == a.size());
+	if (n == 0) return result;
+
+	// output j is the inner product with the second container reversed and rotated (j+1)*shift to the
+	// right, which is element (-1-(j+1)*shift) mod n of the normal circular convolution
+	if (n < CONVOLUTION_FFT_MIN_SIZE) {
+		for (long j = 0; j < n; ++j) {
+			long offset = ((-1 - (j + 1) * (long)shift) % n + n) % n;
+			ValueType1 value = ValueType1(0);
+			for (long k = 0; k <= offset; ++k)
+				value = value + a[k] * b[offset - k];
+			for (long k = offset + 1; k < n; ++k)
+				value = value + a[k] * b[offset - k + n];
+			*result++ = value;
+		}
+		return result;
+	}
+
+	// if n is not a power of two, the linear convolution is calculated with zero padding up to a power
+	// of two and wrapped around afterwards, which is faster than transforms of size n
+	long m = n;
+	if (n & (n - 1)) {
+		m = 1;
+		while (m < 2 * n - 1) m <<= 1;
+	}
+	std::vector<std::complex<double> > fa(m), fb(m);
+	for (long k = 0; k < n; ++k) {
+		fa[k] = std::complex<double>(a[k], 0);
+		fb[k] = std::complex<double>(b[k], 0);
+	}
+	fft(fa);
+	fft(fb);
+	for (long k = 0; k < m; ++k)
+		fa[k] *= fb[k];
+	fft(fa, true);
+	for (long k = n; k < m; ++k)
+		fa[k % n] += fa[k];
+	for (long j = 0; j < n; ++j) {
+		long offset = ((-1 - (j + 1) * (long)shift) % n + n) % n;
+		*result++ = round_to<ValueType1>(fa[offset].real());
+	}
+	return result;
+}
+
 /**
  * This function calculates the discrete convolution between two functions represented by for example
  * vectors or sets. It calculates the product of x[i] and y[shift-i]. So, with shift of 1, it multiplies
@@ -744,6 +1145,10 @@ argmin(ForwardIterator first, ForwardIterator last, UnaryOperation unary_op) {
  * @param			result begin of container for results (needs capacity last1 - first1)
  * @param			(optional) shift with which to calculate the convolution, default 1
  * @return			end of result container
+ *
+ * The second container is rotated in place n times, so it is back in its original order at the end. For
+ * containers of equal size of at least CONVOLUTION_FFT_MIN_SIZE elements the calculation is left to
+ * circular_convolution_copy, which uses the fast Fourier transform and does not rotate anything.
  */
 template<typename ForwardIterator1, typename ForwardIterator2, typename OutputIterator>
 OutputIterator circular_convolution(ForwardIterator1 first1, ForwardIterator1 last1, ForwardIterator2 first2, ForwardIterator2 last2,
@@ -758,6 +1163,8 @@ OutputIterator circular_convolution(ForwardIterator1 first1, ForwardIterator1 la
 	typedef typename std::iterator_traits<ForwardIterator1>::difference_type DistanceType1;
 
 	DistanceType1 dist = std::distance(first1, last1);
+	if ((dist >= CONVOLUTION_FFT_MIN_SIZE) && (std::distance(first2, last2) == dist))
+		return circular_convolution_copy(first1, last1, first2, last2, result, shift);
 	while (dist--) {
 		std::rotate(first2, last2-shift, last2);
 		*result++ = reverse_inner_product(first1, last1, last2, ValueType1(0));
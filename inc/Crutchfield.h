@@ -28,6 +28,9 @@
 // General files
 #include <Histogram.h>
 #include <DistanceSource.h>
+#include <MappedDistanceMatrix.h>
+
+#include <vector>
 
 #ifndef CAREFUL_USAGE
 #define CHECK_DIST
@@ -50,6 +53,8 @@
  * - calcDistances
  * - getDistance for each sensor pair
  *
+ * For frames that come in one by one, there is a sliding window mode: setWindow and then
+ * addFrame for every frame. All distances are then kept up to date over the last frames.
  */
 class Crutchfield: public Histogram, public DistanceSource {
 public:
@@ -71,14 +76,60 @@ public:
 	 *
 	 * This sets all the (conditional) probabilities that are required to do the distance
 	 * calculations. The result is a side-effect in the form of filling a data structure.
+	 *
+	 * The pixel pairs are divided in tiles which are calculated in parallel.
+	 * @param thread_count		number of threads, 0 for one per processor
+	 * @param tile_size			number of pixels along each side of a tile
+	 */
+	void calcDistances(int thread_count = 0, int tile_size = 64);
+
+	/**
+	 * Calculate all distances into a matrix in a file, for when the matrix does not fit in
+	 * memory. The tiles of the matrix that are already done (from a previous run on the same
+	 * data) are skipped. The matrix should be opened with getSensorCount() sensors. The distance
+	 * matrix of this object itself is not used, use the getDistance of the matrix afterwards.
+	 */
+	void calcDistances(MappedDistanceMatrix & matrix, int thread_count = 0);
+
+	/**
+	 * Calculate one tile of a mapped distance matrix and mark it as done.
 	 */
-	void calcDistances();
+	void calcDistances(MappedDistanceMatrix & matrix, int tile0, int tile1);
 
 	/**
 	 * Calculate the Crutchfield distance between two sensors
 	 */
 	Value calcDistance(int p0, int p1);
 
+	/**
+	 * The conditional entropy of sensor p1 given sensor p0, see Histogram::getConditionalEntropy. In
+	 * sliding window mode there are no joint frequencies of the Histogram, it comes from the sums of
+	 * the window instead.
+	 */
+	Value getConditionalEntropy(int p0, int p1);
+
+	/**
+	 * Calculate the distances of all pairs (p0,p1) with p0 in [p0_begin,p0_end), p1 in
+	 * [p1_begin,p1_end) and p1 < p0, and store them in both halves of the distance matrix.
+	 * Can be called in parallel for different tiles after calcDistances has set up the tables.
+	 */
+	void calcDistances(int p0_begin, int p0_end, int p1_begin, int p1_end);
+
+	/**
+	 * Start the sliding window mode. This removes all previous results. The joint frequencies of
+	 * all pairs are kept in memory, window_size should be below 65536 and there are
+	 * p_size*(p_size-1)/2 * bins^2 16-bit counters, so this is meant for small sensor arrays.
+	 * @param window_size		number of frames over which the distances are calculated
+	 */
+	void setWindow(int window_size);
+
+	/**
+	 * Add a frame to the window, if the window is full the oldest frame is removed. All the
+	 * frequencies and distances are updated. It takes constant time per pair of pixels,
+	 * independent of the size of the window.
+	 */
+	void addFrame(pDataMatrix frame);
+
 	/**
 	 * Get previously calculated distance (with calcDistance)
 	 */
@@ -87,11 +138,43 @@ public:
 		return dist[p0*p_size+p1];
 	}
 
+	//! Get number of sensors (implements the one of DistanceSource with the one of ProbMatrix)
+	int getSensorCount() { return p_size; }
+
 protected:
+	//! Fill the n log n table and the marginal sums for all pixels
+	void calcEntropyTables();
+
+	//! Sum over the joint bins of n log n, with n the joint frequency of p0 and p1
+	double calcJointSum(int p0, int p1, std::vector<int> & counts, std::vector<int> & touched);
+
+	//! Distance from the n log n sums, counts and touched are scratch space for calcJointSum
+	Value calcPairDistance(int p0, int p1, std::vector<int> & counts, std::vector<int> & touched);
 
 	//! Distances matrix (these are actual floats)
 	Value *dist;
 
+	//! n log n (natural logarithm) for n = 0 .. frame_count
+	std::vector<double> nlogn;
+
+	//! Sum over the bins of n log n, with n the frequency of pixel p
+	std::vector<double> marginal_sum;
+
+	//! Number of frames in the sliding window (0 if not in sliding window mode)
+	int window_size;
+
+	//! Binned frames in the window, as a ring buffer of window_size frames of p_size bins
+	std::vector<unsigned char> window;
+
+	//! Position in the ring buffer of the next frame
+	int window_next;
+
+	//! Joint frequencies of all pairs p1 < p0, bins^2 per pair, pair index p0*(p0-1)/2+p1
+	std::vector<unsigned short> pair_counts;
+
+	//! Sum over the joint bins of n log n, per pair
+	std::vector<double> joint_sum;
+
 private:
 
 
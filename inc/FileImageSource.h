@@ -47,7 +47,7 @@ template <typename Image>
 class FileImageSource: public ImageSource<Image> {
 public:
 	//! Constructor FileImageSource
-	FileImageSource(): file_ptr(-1), copy_reverse_series(true) {
+	FileImageSource(): file_ptr(-1), copy_reverse_series(true), receive_time(0) {
 		filenames.clear();
 	}
 
@@ -102,10 +102,12 @@ public:
 	/**
 	 * Get a specific image with given name, should reside in previously set path.
 	 * Assumes that there is a constructor that accepts a filename and returns an Image object.
+	 * The image counts as received when it has been loaded and decoded.
 	 */
 	Image* getImage(std::string file) {
 		file = this->img_path + '/' + file;
 		Image *img = new Image(file.c_str());
+		receive_time = dobots::get_time_us();
 		return img;
 	}
 
@@ -120,6 +122,9 @@ public:
 	}
 
 protected:
+	//! Time at which the last image has been loaded
+	long long getReceiveTime() { return receive_time; }
+
 	//! Return next file from the previously build up vector with image filenames
 	std::string nextFile() {
 		if (file_ptr < 0) {
@@ -141,6 +146,9 @@ private:
 
 	//! Use the entire series in reverse (convenient for tracking)
 	bool copy_reverse_series;
+
+	//! Time at which the last image has been loaded
+	long long receive_time;
 };
 
 #endif /* FILEIMAGESOURCE_H_ */
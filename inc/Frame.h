@@ -0,0 +1,59 @@
+/**
+ * @brief An image together with information on when and where it has been obtained
+ * @file Frame.h
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 4, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+
+#ifndef FRAME_H_
+#define FRAME_H_
+
+#include <cstddef>
+
+/**
+ * A frame is an image plus its "metadata". The receive time is taken from the monotonic clock
+ * in Timer.hpp at the moment the image became available to us (the last byte arrived over the
+ * network, or the file has been loaded). It is not the capture time of the camera, which we do
+ * not know. The sequence number is incremented by the source for every frame it hands out, so
+ * gaps show which frames have been dropped further down the pipeline.
+ *
+ * A frame does not own its image, whoever gets the frame from a source deletes the image.
+ */
+template <typename Image>
+struct Frame {
+	Frame(): image(NULL), receive_time(0), sequence(0), source_id(0) {}
+
+	Frame(Image *image, long long receive_time, long sequence, int source_id): image(image),
+			receive_time(receive_time), sequence(sequence), source_id(source_id) {}
+
+	//! The image itself (NULL if there was no image)
+	Image *image;
+
+	//! Time in microseconds at which the image has been received, see dobots::get_time_us()
+	long long receive_time;
+
+	//! Number of the frame within its source, starting at 0
+	long sequence;
+
+	//! Identifier of the source of the frame, see ImageSource::SetSourceId
+	int source_id;
+};
+
+#endif /* FRAME_H_ */
@@ -0,0 +1,157 @@
+/**
+ * @brief Bounded queue of frames with a policy for when it is full
+ * @file FrameQueue.h
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 5, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+
+#ifndef FRAMEQUEUE_H_
+#define FRAMEQUEUE_H_
+
+#include <deque>
+#include <cassert>
+
+#include <Frame.h>
+
+/**
+ * What to do with frames that come in faster than they can be tracked:
+ *  - DP_BLOCK, the producer has to wait till there is space (nothing is dropped)
+ *  - DP_KEEP_LATEST, a new frame replaces everything that is waiting
+ *  - DP_DROP_OLDEST, if the queue is full the oldest frame makes room for the new one
+ *  - DP_DECIMATE, only every n-th frame is accepted, if the queue is still full the oldest frame
+ *    is dropped
+ */
+enum DropPolicy { DP_BLOCK, DP_KEEP_LATEST, DP_DROP_OLDEST, DP_DECIMATE };
+
+/* **************************************************************************************
+ * Interface of FrameQueue
+ * **************************************************************************************/
+
+/**
+ * A bounded first-in first-out queue of frames. The queue owns the images of the frames in it,
+ * so the images of dropped frames are deleted here. A frame that is popped belongs to the
+ * caller again. There is no locking, the queue is meant to be protected by the mutex of its
+ * owner (see IngestionManager).
+ */
+template <typename Image>
+class FrameQueue {
+public:
+	/**
+	 * Constructor.
+	 * @param capacity		maximum number of frames waiting
+	 * @param policy		what to do on a full queue
+	 * @param decimation	for DP_DECIMATE, accept one out of this many frames
+	 */
+	FrameQueue(int capacity = 4, DropPolicy policy = DP_BLOCK, int decimation = 1):
+		capacity(capacity), policy(policy), decimation(decimation), offered(0), dropped(0),
+		decimated(0) {
+		assert (capacity > 0 && decimation > 0);
+	}
+
+	//! Destructor, deletes the images that are still waiting
+	~FrameQueue() { Clear(); }
+
+	//! Change the policy (counters are kept)
+	void SetPolicy(DropPolicy policy, int decimation = 1) {
+		assert (decimation > 0);
+		this->policy = policy;
+		this->decimation = decimation;
+	}
+
+	/**
+	 * Offer a frame to the queue. With DP_BLOCK and a full queue the frame is not taken and the
+	 * caller should try again later, in all other cases the queue takes care of the frame (which
+	 * might mean it gets dropped right away).
+	 * @return				false if the frame has not been taken
+	 */
+	bool Push(const Frame<Image> & frame) {
+		if (policy == DP_BLOCK && Full()) return false;
+		long n = offered++;
+		if (policy == DP_DECIMATE && (n % decimation)) {
+			delete frame.image;
+			decimated++;
+			return true;
+		}
+		if (policy == DP_KEEP_LATEST) {
+			while (!queue.empty()) DropFront();
+		}
+		while (Full()) DropFront();
+		queue.push_back(frame);
+		return true;
+	}
+
+	//! Take the oldest frame, false if the queue is empty
+	bool Pop(Frame<Image> & frame) {
+		if (queue.empty()) return false;
+		frame = queue.front();
+		queue.pop_front();
+		return true;
+	}
+
+	//! Delete all waiting frames (these are not counted as dropped)
+	void Clear() {
+		for (size_t i = 0; i < queue.size(); ++i) delete queue[i].image;
+		queue.clear();
+	}
+
+	//! Number of frames waiting
+	inline int Size() const { return queue.size(); }
+
+	inline bool Empty() const { return queue.empty(); }
+
+	inline bool Full() const { return (int)queue.size() >= capacity; }
+
+	inline int GetCapacity() const { return capacity; }
+
+	inline DropPolicy GetPolicy() const { return policy; }
+
+	//! Number of frames offered to the queue
+	inline long Offered() const { return offered; }
+
+	//! Number of frames dropped because the queue was full (or a newer one came in)
+	inline long Dropped() const { return dropped; }
+
+	//! Number of frames skipped by decimation
+	inline long Decimated() const { return decimated; }
+
+protected:
+	void DropFront() {
+		delete queue.front().image;
+		queue.pop_front();
+		dropped++;
+	}
+
+private:
+	std::deque<Frame<Image> > queue;
+
+	int capacity;
+
+	DropPolicy policy;
+
+	int decimation;
+
+	long offered;
+
+	long dropped;
+
+	long decimated;
+};
+
+#endif /* FRAMEQUEUE_H_ */
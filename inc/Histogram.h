@@ -49,7 +49,7 @@ typedef std::vector<Value> NormalizedHistogramValues;
 class Histogram: public ProbMatrix {
 public:
 	//! Constructor with number of bins and the size of the frames
-	Histogram(int bins, int width, int height);
+	Histogram(int bins, int width, int height, HistogramMode mode = HM_PER_PIXEL);
 
 	//! Destructor
 	virtual ~Histogram();
@@ -72,6 +72,10 @@ public:
 	 *  - getProbability
 	 *  - getJointProbability
 	 *  - getConditionalEntropy
+	 *
+	 *  In HM_GLOBAL mode only the frequencies over all pixels are counted, in a single pass over
+	 *  the data. Then only getFrequencies, getProbabilities and getSamples can be used. The data
+	 *  frames should contain as many planes as set by setChannels.
 	 */
 	void calcProbabilities(DataFrames & frames);
 
@@ -93,6 +97,13 @@ public:
 		return bin;
 	}
 
+	/**
+	 * The same as value2bin, but by table lookup, so without division. Only for 8-bit values.
+	 */
+	inline int lookupBin(unsigned char v) {
+		return bin_table[v];
+	}
+
 	/**
 	 * The other (default) function returns the frequency of data events of an individual sensor over
 	 * time. A value is counted several times to fall into bin X over a set of frames, and then
@@ -110,6 +121,11 @@ public:
 	 * Exactly the same as getFrequencies, but now normalised with the sum of all events.
 	 */
 	void getProbabilities(NormalizedHistogramValues &bin_result);
+protected:
+	//! Fill global_freq, for HM_GLOBAL mode
+	void calcGlobalFrequencies(DataFrames & frames);
+
+public:
 #ifdef DEBUG
 	//! Print distances
 	void printDistances();
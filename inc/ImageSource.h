@@ -29,6 +29,9 @@
 #include <CImg.h>
 #include <string>
 
+#include <Frame.h>
+#include <Timer.hpp>
+
 /* **************************************************************************************
  * Interface of ImageSource
  * **************************************************************************************/
@@ -37,7 +40,8 @@ template <typename Image>
 class ImageSource {
 public:
 	//! Constructor ImageSource
-	ImageSource(): img_path(""), img_basename("image"), img_extension(".jpeg") {}
+	ImageSource(): img_path(""), img_basename("image"), img_extension(".jpeg"), source_id(0),
+		frame_sequence(0) {}
 
 	//! Destructor ~ImageSource
 	virtual ~ImageSource() {}
@@ -51,6 +55,23 @@ public:
 	//! Get an image but shifted in maximum two directions.
 	virtual Image* getImageShifted(int shift_x, int shift_y) = 0;
 
+	/**
+	 * Get the next image as a frame, so with receive time, sequence number and source id. By
+	 * default the receive time is the moment getImage() returns. Sources that know better, for
+	 * example when the last byte of an image came in, override getReceiveTime().
+	 */
+	Frame<Image> getFrame() {
+		Image *img = getImage();
+		if (img == NULL) return Frame<Image>();
+		return Frame<Image>(img, getReceiveTime(), frame_sequence++, source_id);
+	}
+
+	//! Set the id that will be put in the frames of this source
+	void SetSourceId(int id) { source_id = id; }
+
+	//! Get the id of this source
+	int GetSourceId() { return source_id; }
+
 	//! Get the path
 	void SetPath(std::string path) { img_path = path; }
 
@@ -70,6 +91,16 @@ protected:
 	//! Mask for the extensions of the pictures to be found or stored
 	std::string img_extension;
 
+	//! Time at which the image returned by the last call to getImage() has been received
+	virtual long long getReceiveTime() { return dobots::get_time_us(); }
+
+private:
+	//! Id to be used in the frames
+	int source_id;
+
+	//! Sequence number of the next frame
+	long frame_sequence;
+
 };
 
 #endif /* IMAGESOURCE_H_ */
@@ -0,0 +1,183 @@
+/**
+ * @brief Run a tracker for each of multiple cameras
+ * @file IngestionManager.h
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 3, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+
+#ifndef INGESTIONMANAGER_H_
+#define INGESTIONMANAGER_H_
+
+// General files
+#include <pthread.h>
+#include <vector>
+
+#include <CImg.h>
+#include <Frame.h>
+#include <FrameQueue.h>
+#include <ImageSource.h>
+#include <PositionParticleFilter.h>
+#include <StreamStats.h>
+#include <ThreadPool.h>
+
+/* **************************************************************************************
+ * Interface of IngestionManager
+ * **************************************************************************************/
+
+/**
+ * The ingestion manager owns a number of streams, each consisting of an image source and a
+ * particle filter that tracks something in the images of that source.
+ *
+ * Every stream has its own acquisition thread, because getting an image from a camera is
+ * mainly waiting on the network. The images are put in a queue per stream. The ticks of the
+ * particle filters, the actual computational work, are scheduled on a thread pool that is
+ * shared by all streams. There is never more than one tick of the same filter scheduled at
+ * the same time, so frames of one stream are tracked in order.
+ *
+ * Usage:
+ *   AddStream (for each camera, with an initialized filter), Start, GetStats, ..., Stop
+ */
+class IngestionManager {
+public:
+	typedef CImg<DataValue> Image;
+
+	/**
+	 * Constructor.
+	 * @param pool				thread pool to run the filter ticks on (not owned)
+	 * @param max_queue_depth	maximum number of images waiting per stream
+	 * @param policy			what to do if the queue of a stream is full, by default
+	 * 							acquisition of that stream waits
+	 * @param decimation		for DP_DECIMATE, track one out of this many frames
+	 */
+	IngestionManager(ThreadPool & pool, int max_queue_depth = 4, DropPolicy policy = DP_BLOCK,
+			int decimation = 1);
+
+	//! Destructor, stops the streams and deletes the sources and filters
+	~IngestionManager();
+
+	/**
+	 * Add a stream, the manager takes ownership of the source and the filter. The source should
+	 * be updated and the filter initialized. Streams can only be added when not running. The
+	 * source id of the image source is set to the id of the stream.
+	 * @return					the id of the stream
+	 */
+	int AddStream(ImageSource<Image> *source, PositionParticleFilter *filter, int subticks = 1);
+
+	//! Start acquisition threads for all streams
+	bool Start();
+
+	//! Stop acquisition and wait for the images in the queues to be tracked
+	void Stop();
+
+	//! Number of streams
+	inline int GetStreamCount() { return streams.size(); }
+
+	//! Get the statistics of one stream
+	void GetStats(int id, StreamStats & stats);
+
+	//! Get the filter of a stream, only inspect it when the stream is not running
+	PositionParticleFilter *GetFilter(int id) { return streams[id]->filter; }
+
+	//! Print the statistics of all streams
+	void PrintStats(std::ostream & os);
+
+protected:
+	/**
+	 * Everything that belongs to one camera.
+	 */
+	struct Stream {
+		int id;
+		ImageSource<Image> *source;
+		PositionParticleFilter *filter;
+		int subticks;
+
+		//! Frames waiting to be tracked
+		FrameQueue<Image> *queue;
+
+		//! True if a tick of the filter is scheduled or running
+		bool tracking;
+
+		//! Statistics (queue_depth and rates are filled in on request)
+		StreamStats stats;
+
+		//! Acquisition thread
+		pthread_t thread;
+
+		//! True if the acquisition thread has been started
+		bool started;
+
+		//! Protects the queue, the tracking flag, and the statistics
+		pthread_mutex_t mutex;
+
+		//! Signalled when there is space in the queue again (only used with DP_BLOCK)
+		pthread_cond_t not_full;
+
+		//! Back reference, to be able to use the stream as thread argument
+		IngestionManager *manager;
+	};
+
+	/**
+	 * Task that ticks the filter of a stream with the oldest image in its queue.
+	 */
+	class TrackTask: public Task {
+	public:
+		TrackTask(IngestionManager *manager, Stream *stream): manager(manager), stream(stream) {}
+		void Run() { manager->Track(*stream); }
+	private:
+		IngestionManager *manager;
+		Stream *stream;
+	};
+
+	//! Entry point for the acquisition threads
+	static void *Acquire(void *stream);
+
+	//! Get images from the source of the stream till the manager is stopped
+	void Acquire(Stream & stream);
+
+	//! Tick the filter with one image and reschedule if there are more
+	void Track(Stream & stream);
+
+private:
+	//! All streams
+	std::vector<Stream*> streams;
+
+	//! Pool for the ticks
+	ThreadPool & pool;
+
+	//! All track tasks belong to this group
+	TaskGroup group;
+
+	//! Maximum number of images per stream in the queue
+	int max_queue_depth;
+
+	//! Policy for full queues
+	DropPolicy policy;
+
+	//! Decimation factor for DP_DECIMATE
+	int decimation;
+
+	//! Time at which the streams have been started
+	long long start_time;
+
+	//! Set to false to stop acquisition
+	volatile bool running;
+};
+
+#endif /* INGESTIONMANAGER_H_ */
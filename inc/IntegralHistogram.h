@@ -0,0 +1,97 @@
+/**
+ * @brief Histograms of arbitrary rectangles of an image in constant time
+ * @file IntegralHistogram.h
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 12, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+
+#ifndef INTEGRALHISTOGRAM_H_
+#define INTEGRALHISTOGRAM_H_
+
+// General files
+#include <Histogram.h>
+
+#include <vector>
+
+/* **************************************************************************************
+ * Interface of IntegralHistogram
+ * **************************************************************************************/
+
+/**
+ * The integral histogram of an image stores for every pixel the histogram of the rectangle from
+ * the top-left corner up to that pixel. The histogram of any rectangle then follows from four of
+ * them, in time proportional to the number of bins and independent of the size of the rectangle.
+ * It is calculated once per frame and shared by everything that needs histograms of regions of
+ * that frame, such as all particles of all tracked targets.
+ *
+ * The bins are the same as those of a Histogram in HM_GLOBAL mode with the same bins, channels
+ * and channel mode, so the probabilities of a rectangle are the same as those of Histogram on a
+ * crop of that rectangle.
+ *
+ * The counts are 32-bit, so rectangles of any size up to the entire image can be used. The memory
+ * needed is (width+1)*(height+1)*getHistogramSize()*4 bytes, for example 5MB for 320x240 pixels
+ * and 16 bins, but 160MB for 512 joint RGB bins. For colour, concatenated channels are a better fit.
+ *
+ * Usage:
+ *   calcIntegral (for every frame), getProbabilities (for every rectangle)
+ */
+class IntegralHistogram: public ProbMatrix {
+public:
+	//! Constructor with the number of bins (per channel) and the channels to use
+	IntegralHistogram(int bins, int channels = 1, ChannelMode channel_mode = CM_JOINT);
+
+	//! Destructor ~IntegralHistogram
+	virtual ~IntegralHistogram();
+
+	/**
+	 * Calculate the integral histogram of an image, with its channels as planes one after another
+	 * (the CImg layout). If the image has less channels than configured, only those are used.
+	 * @param data			the pixel values
+	 * @param width			width of the image
+	 * @param height		height of the image
+	 * @param spectrum		number of channels (planes) in the data
+	 */
+	void calcIntegral(pDataMatrix data, int width, int height, int spectrum = 1);
+
+	/**
+	 * Get the normalized histogram of the rectangle [x0,x1]x[y0,y1] (inclusive, like CImg::get_crop).
+	 * The part of the rectangle outside of the image is ignored. The result is all zeros if nothing
+	 * of the rectangle is inside the image.
+	 */
+	void getProbabilities(int x0, int y0, int x1, int y1, NormalizedHistogramValues & result) const;
+
+	//! Width of the image of the last calcIntegral
+	inline int getWidth() const { return p_width; }
+
+	//! Height of the image of the last calcIntegral
+	inline int getHeight() const { return p_height; }
+
+private:
+	//! Number of channels asked for in the constructor (images can have less)
+	int configured_channels;
+
+	//! Number of values per histogram (cached getHistogramSize)
+	int size;
+
+	//! Histogram counts, (width+1)*(height+1) histograms of size values, row after row
+	std::vector<unsigned int> integral;
+};
+
+#endif /* INTEGRALHISTOGRAM_H_ */
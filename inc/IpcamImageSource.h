@@ -44,7 +44,7 @@ class IpcamImageSource: public ImageSource<Image> {
 public:
 	//! Constructor IpcamImageSource
 	IpcamImageSource(): quiet_flag(true), debug(false),
-	connect_to_http_server_timeout(5), wait_per_package(1000) {
+	connect_to_http_server_timeout(5), wait_per_package(1000), receive_time(0), frame_number(-1) {
 		http_server = "10.10.1.113";
 		http_port = 80;
 		//		dframes_per_second = 20;
@@ -127,6 +127,10 @@ public:
 				continue;
 			}
 
+			// the decoding below is ours, so the frame has been received now
+			receive_time = dobots::get_time_us();
+			if (!img_buffer.get_item_frame_number(header_size, frame_number)) frame_number = -1;
+
 			std::ostringstream oss; oss.clear(); oss.str("");
 			oss << this->img_path << '/' << this->img_basename << img_buffer.get_frame_number() << this->img_extension;
 			std::string file = oss.str();
@@ -153,7 +157,21 @@ public:
 		return NULL;
 	}
 
+	//! Set the name or IP address and the port of the camera (call before Update)
+	void SetServer(std::string server, int port) {
+		http_server = server;
+		http_port = port;
+	}
+
+	//! Set the time (in microseconds) to wait before each attempt to read a new package
+	void SetWaitPerPackage(int wait) { wait_per_package = wait; }
+
+	//! The frame number the server put on the last image (see MjpegServer), -1 if it did not
+	inline long GetFrameNumber() { return frame_number; }
+
 protected:
+	//! Time the last byte of the image returned by getImage() came in
+	long long getReceiveTime() { return receive_time; }
 
 	/**
 	 * Connect to the server at a specific address and port.
@@ -306,6 +324,12 @@ private:
 //	int dframes_per_second;
 	int wait_per_package;
 
+	//! Time at which the last complete image has been received
+	long long receive_time;
+
+	//! Frame number in the header of the last image, -1 if there was none
+	long frame_number;
+
 	//! Password or access string for the camera
 	std::string access_string;
 
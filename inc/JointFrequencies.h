@@ -0,0 +1,154 @@
+/**
+ * @brief Compact storage of joint frequencies between all pairs of pixels
+ * @file JointFrequencies.h
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 9, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+
+#ifndef JOINTFREQUENCIES_H_
+#define JOINTFREQUENCIES_H_
+
+// General files
+#include <vector>
+#include <map>
+#include <deque>
+#include <cstddef>
+
+/* **************************************************************************************
+ * Interface of JointFrequencies
+ * **************************************************************************************/
+
+/**
+ * The joint frequencies of all pixel pairs take bins^2 x pixels^2 counters, which is 4GB for
+ * a 64x64 image with 16 bins. However, everything can be derived from the time series of bins
+ * of every pixel, which is only pixels x frames bytes. This class stores that time series and
+ * calculates the joint frequencies on request, for a whole block of pixel pairs at once. Only
+ * a limited number of blocks is kept in memory (the oldest is removed first), so going through
+ * the pairs block by block, as Crutchfield does, calculates every block only once.
+ *
+ * A block contains the pairs (p0,p1) with p0 in [B*i, B*(i+1)) and p1 in [B*j, B*(j+1)), and
+ * only blocks with i >= j exist, because the joint frequencies are symmetric. Per pair the
+ * counts are stored:
+ *  - dense, bins^2 counters, 16-bit when there are less than 65536 frames
+ *  - sparse, only the non-zero counters, when there are less than bins^2/2 frames (a pair can
+ *    not have more different bin combinations than there are frames)
+ */
+class JointFrequencies {
+public:
+	//! Constructor, with the number of bins, the number of pixels, and the size of a block
+	JointFrequencies(int bins, int p_size, int block_size = 32);
+
+	//! Destructor ~JointFrequencies
+	~JointFrequencies();
+
+	/**
+	 * Store the time series of bins. The bins are given per frame, like the data frames.
+	 * @param binned		for every frame, an array with the bin of each of the p_size pixels
+	 */
+	void setBins(const std::vector<unsigned char*> & binned);
+
+	/**
+	 * The number of times pixel p0 has been in bin0 while p1 has been in bin1. This is zero if
+	 * p0 == p1.
+	 */
+	int getJointFrequency(int p0, int bin0, int p1, int bin1);
+
+	/**
+	 * Count the joint frequencies of a single pair directly from the time series, without the
+	 * blocks, so this can be called from multiple threads.
+	 * @param counts		bins^2 counters, index bin0 + bins*bin1, will be overwritten
+	 */
+	void getPairFrequencies(int p0, int p1, std::vector<int> & counts) const;
+
+	//! The bin of pixel p in frame t
+	inline int getBin(int p, int t) const { return series[(size_t)p*frame_count+t]; }
+
+	//! The time series of pixel p (frame_count values)
+	inline const unsigned char *getSeries(int p) const { return &series[(size_t)p*frame_count]; }
+
+	//! Get number of frames
+	inline int getFrameCount() const { return frame_count; }
+
+	//! Set the maximum memory (in bytes) for blocks in the cache (at least one block is kept)
+	void setMemoryLimit(size_t bytes) { memory_limit = bytes; }
+
+	//! True if pairs are stored in sparse form
+	inline bool isSparse() const { return sparse; }
+
+protected:
+	//! Joint frequencies for a block of pairs
+	struct Block {
+		//! Dense 16-bit counters
+		std::vector<unsigned short> counts16;
+		//! Dense 32-bit counters
+		std::vector<int> counts32;
+		//! Sparse: per pair the range [offset[pair], offset[pair+1]) in index/count
+		std::vector<unsigned int> offset;
+		//! Sparse: joint bin index (bin0 + bins*bin1)
+		std::vector<unsigned short> index;
+		//! Sparse: count for the joint bin
+		std::vector<unsigned short> count;
+		//! Memory in use
+		size_t bytes;
+	};
+
+	//! Get the block from the cache or calculate it
+	Block *getBlock(int block0, int block1);
+
+	//! Calculate all joint frequencies of a block
+	void calcBlock(int block0, int block1, Block & block);
+
+	//! Remove all blocks
+	void Clear();
+
+private:
+	int bins;
+
+	int bins_squared;
+
+	int p_size;
+
+	int block_size;
+
+	int frame_count;
+
+	//! Time series of bins, pixel-major: series[p*frame_count+t]
+	std::vector<unsigned char> series;
+
+	//! Store sparse (decided on setBins)
+	bool sparse;
+
+	//! The blocks in memory, key is block0 * block_count + block1
+	std::map<int, Block*> blocks;
+
+	//! Order in which blocks have been added
+	std::deque<int> order;
+
+	//! Number of blocks in a row
+	int block_count;
+
+	//! Memory limit for the blocks
+	size_t memory_limit;
+
+	//! Memory used by the blocks
+	size_t memory_used;
+};
+
+#endif /* JOINTFREQUENCIES_H_ */
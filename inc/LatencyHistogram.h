@@ -0,0 +1,141 @@
+/**
+ * @brief Histogram of latencies with logarithmic buckets
+ * @file LatencyHistogram.h
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 4, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+
+#ifndef LATENCYHISTOGRAM_H_
+#define LATENCYHISTOGRAM_H_
+
+#include <iostream>
+#include <algorithm>
+
+/**
+ * Latencies in microseconds are counted in buckets that double in size every four buckets, so
+ * a bucket is never wider than a quarter of its lower bound. This covers everything from a
+ * microsecond to hours in a fixed array, and percentiles are off by at most that amount. It is
+ * a plain value type, so it can be copied around as part of a statistics snapshot.
+ */
+class LatencyHistogram {
+public:
+	//! Number of buckets, enough for any positive long long
+	static const int Buckets = 256;
+
+	LatencyHistogram() { Clear(); }
+
+	//! Remove all samples
+	void Clear() {
+		std::fill(counts, counts + Buckets, 0L);
+		count = 0;
+		sum = 0;
+		min = 0;
+		max = 0;
+	}
+
+	//! Add a latency (in microseconds), negative values are counted as 0
+	void Add(long long us) {
+		if (us < 0) us = 0;
+		counts[Bucket(us)]++;
+		if (!count || us < min) min = us;
+		if (!count || us > max) max = us;
+		sum += us;
+		count++;
+	}
+
+	//! Add all samples of another histogram
+	void Add(const LatencyHistogram & other) {
+		if (!other.count) return;
+		for (int i = 0; i < Buckets; ++i) counts[i] += other.counts[i];
+		if (!count || other.min < min) min = other.min;
+		if (!count || other.max > max) max = other.max;
+		sum += other.sum;
+		count += other.count;
+	}
+
+	//! Number of samples
+	inline long Count() const { return count; }
+
+	//! Smallest latency
+	inline long long Min() const { return min; }
+
+	//! Largest latency
+	inline long long Max() const { return max; }
+
+	//! Average latency
+	inline double Mean() const { return count ? (double)sum / count : 0; }
+
+	/**
+	 * Estimate of the latency below which a fraction p of the samples lies, interpolated
+	 * linearly within the bucket that contains it.
+	 * @param p				fraction in [0,1], e.g. 0.5 for the median
+	 */
+	long long Percentile(double p) const {
+		if (!count) return 0;
+		p = std::max(0.0, std::min(1.0, p));
+		double target = p * count;
+		long cumulative = 0;
+		for (int i = 0; i < Buckets; ++i) {
+			if (!counts[i]) continue;
+			if (cumulative + counts[i] >= target) {
+				double fraction = (target - cumulative) / counts[i];
+				long long low = Lower(i), high = Lower(i+1);
+				long long value = low + (long long)(fraction * (high - low));
+				return std::max(min, std::min(max, value));
+			}
+			cumulative += counts[i];
+		}
+		return max;
+	}
+
+	//! Easy printing (in milliseconds)
+	friend std::ostream& operator<<(std::ostream& os, const LatencyHistogram & h) {
+		os << "latency min " << h.Min() / 1000.0 << " median " << h.Percentile(0.5) / 1000.0
+				<< " p95 " << h.Percentile(0.95) / 1000.0 << " max " << h.Max() / 1000.0 << " ms";
+		return os;
+	}
+
+protected:
+	//! Values 0..3 have their own bucket, above that there are four buckets per power of two
+	static int Bucket(long long us) {
+		if (us < 4) return (int)us;
+		int e = 0;
+		for (long long v = us; v > 1; v >>= 1) e++;
+		int sub = (int)(us >> (e-2)) & 3;
+		return 4*(e-1) + sub;
+	}
+
+	//! Smallest value that falls in the given bucket
+	static long long Lower(int bucket) {
+		if (bucket < 4) return bucket;
+		int e = bucket / 4 + 1;
+		int sub = bucket % 4;
+		return (long long)(4 + sub) << (e-2);
+	}
+
+private:
+	long counts[Buckets];
+	long count;
+	long long sum;
+	long long min;
+	long long max;
+};
+
+#endif /* LATENCYHISTOGRAM_H_ */
@@ -0,0 +1,150 @@
+/**
+ * @brief Distance matrix stored in a memory-mapped file
+ * @file MappedDistanceMatrix.h
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 11, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+
+#ifndef MAPPEDDISTANCEMATRIX_H_
+#define MAPPEDDISTANCEMATRIX_H_
+
+// General files
+#include <string>
+#include <cstddef>
+
+#include <DistanceSource.h>
+
+/* **************************************************************************************
+ * Interface of MappedDistanceMatrix
+ * **************************************************************************************/
+
+/**
+ * A symmetric distance matrix in a file that is mapped in memory, so it can be larger than the
+ * memory (the operating system keeps the parts in use in memory) and it survives the program.
+ *
+ * Only the lower triangle is stored, in square tiles of tile_size x tile_size floats, so a
+ * tile can be calculated and written in one go. For every tile there is a flag in the file that
+ * tells if it has been calculated. When a calculation is interrupted, or the same data is used
+ * again, only the tiles that are not done yet need to be calculated.
+ *
+ * The file starts with a header with the number of sensors, the tile size and a key chosen by
+ * the user (for example a hash of the input data and settings). A file is only reused if all of
+ * these match, otherwise it is overwritten.
+ *
+ * Usage:
+ *   Open, then fill the tiles (see Crutchfield::calcDistances), getDistance, Close
+ */
+class MappedDistanceMatrix: public DistanceSource {
+public:
+	//! Constructor MappedDistanceMatrix
+	MappedDistanceMatrix();
+
+	//! Destructor, closes the file
+	virtual ~MappedDistanceMatrix();
+
+	/**
+	 * Open or create the file.
+	 * @param filename			file to be used
+	 * @param sensor_count		number of sensors (rows/columns of the matrix)
+	 * @param tile_size			number of sensors along a side of a tile
+	 * @param key				identifies the data, a file with another key is not reused
+	 * @return					false if the file could not be opened or mapped
+	 */
+	bool Open(const std::string & filename, int sensor_count, int tile_size = 64,
+			unsigned long long key = 0);
+
+	//! Write everything to disk and unmap the file
+	void Close();
+
+	//! Write changes to disk
+	void Sync();
+
+	//! Get distance, 0 if sensor0 == sensor1
+	float getDistance(int sensor0, int sensor1);
+
+	//! Get number of sensors
+	int getSensorCount() { return sensor_count; }
+
+	//! Number of tiles along a side of the matrix
+	inline int getTileCount() { return tile_count; }
+
+	//! Number of sensors along a side of a tile
+	inline int getTileSize() { return tile_size; }
+
+	/**
+	 * The tile with the distances of sensors in [tile0*tile_size, (tile0+1)*tile_size) to the ones
+	 * in [tile1*tile_size, (tile1+1)*tile_size), with tile1 <= tile0. The distance of p0 to p1 is
+	 * at [(p0 % tile_size) * tile_size + p1 % tile_size].
+	 */
+	float *getTile(int tile0, int tile1);
+
+	//! True if the tile has been calculated
+	bool isTileDone(int tile0, int tile1);
+
+	//! Mark a tile as calculated, call after all its values have been written
+	void setTileDone(int tile0, int tile1);
+
+	//! Number of tiles that are done
+	int getTilesDone();
+
+	//! Number of tiles (in the lower triangle, including the diagonal)
+	inline int getTilePairs() { return tile_count * (tile_count + 1) / 2; }
+
+protected:
+	//! Index of a tile in the lower triangle
+	inline size_t tileIndex(int tile0, int tile1) { return (size_t)tile0 * (tile0 + 1) / 2 + tile1; }
+
+	//! Header at the start of the file
+	struct Header {
+		char magic[8];
+		int version;
+		int sensor_count;
+		int tile_size;
+		int tile_count;
+		unsigned long long key;
+		unsigned long long flags_offset;
+		unsigned long long data_offset;
+		unsigned long long file_size;
+	};
+
+private:
+	//! File descriptor
+	int fd;
+
+	//! Mapped file
+	char *map;
+
+	//! Size of the mapping
+	size_t map_size;
+
+	//! Tile done flags (one byte per tile, so they can be set from multiple threads)
+	unsigned char *flags;
+
+	//! Tiles
+	float *data;
+
+	int sensor_count;
+
+	int tile_size;
+
+	int tile_count;
+};
+
+#endif /* MAPPEDDISTANCEMATRIX_H_ */
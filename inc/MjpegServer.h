@@ -0,0 +1,319 @@
+/**
+ * @brief Local stand-in for an MJPEG streaming IP camera
+ * @file MjpegServer.h
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 2, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+
+#ifndef MJPEGSERVER_H_
+#define MJPEGSERVER_H_
+
+// General files
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+#include <fstream>
+#include <cassert>
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <File.hpp>
+#include <alphanum.hpp>
+#include <Timer.hpp>
+
+/* **************************************************************************************
+ * Interface of MjpegServer
+ * **************************************************************************************/
+
+/**
+ * A minimal HTTP server on the loopback interface that streams recorded JPEG frames in the
+ * same way as the DCS-900 camera does: after a "GET /video.cgi" request it keeps sending
+ * items with a "Content-type: image/jpeg" and "Content-length: " header followed by the
+ * JPEG data. Every item also gets an "X-Frame-Number: " header with the index of the frame
+ * for the current client, as streaming servers such as mjpg-streamer add to their items. It
+ * runs in its own thread, so it can be used in-process to test and benchmark IpcamImageSource
+ * without the actual camera.
+ *
+ * Usage:
+ *   LoadFrames, (SetFrameRate, SetJitter, SetFragmentation), Start, ..., Stop
+ * The time at which each frame has been sent can be obtained with GetSendTime, which makes
+ * it possible to measure the latency on the receiving side, given the frame number of the
+ * received item (see IpcamImageSource::GetFrameNumber).
+ */
+class MjpegServer {
+public:
+	//! Constructor, a port of 0 lets the operating system pick a free port
+	MjpegServer(int port = 0): port(port), listenfd(-1), period_us(50000), jitter_us(0),
+		fragment_min(0), fragment_max(0), fragment_delay_us(0), frames_sent(0), running(false) {
+		frames.clear();
+		send_times.clear();
+		pthread_mutex_init(&mutex, NULL);
+	}
+
+	//! Destructor, stops the server if it is still running
+	virtual ~MjpegServer() {
+		Stop();
+		pthread_mutex_destroy(&mutex);
+	}
+
+	/**
+	 * Read all files with the given extension in the path as frames. They are sorted such
+	 * that the one with the lowest "postfix" comes first (image1.jpg ... image10.jpg).
+	 */
+	bool LoadFrames(const std::string & path, const std::string & extension) {
+		std::vector<std::string> filenames;
+		if (!dobots::getFilenames(filenames, path, extension, true)) return false;
+		std::sort(filenames.begin(), filenames.end(), doj::alphanum_less<std::string>());
+		for (size_t i = 0; i < filenames.size(); ++i) {
+			std::string file = path + '/' + filenames[i];
+			std::ifstream in(file.c_str(), std::ios::in | std::ios::binary);
+			if (!in) continue;
+			std::vector<char> jpeg((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+			AddFrame(jpeg);
+		}
+		return !frames.empty();
+	}
+
+	//! Add a single frame (should be a complete JPEG image)
+	void AddFrame(const std::vector<char> & jpeg) {
+		frames.push_back(jpeg);
+	}
+
+	//! Number of frames per second that will be streamed
+	void SetFrameRate(float frames_per_second) {
+		assert (frames_per_second > 0);
+		period_us = 1000000 / frames_per_second;
+	}
+
+	//! Uniformly distributed deviation (in microseconds) from the nominal frame period
+	void SetJitter(int jitter_us) { this->jitter_us = jitter_us; }
+
+	/**
+	 * Send each item in fragments with a random size between min_size and max_size bytes,
+	 * with a pause of "delay_us" microseconds in between. A max_size of 0 disables it.
+	 */
+	void SetFragmentation(int min_size, int max_size, int delay_us = 0) {
+		assert (min_size <= max_size);
+		fragment_min = std::max(1, min_size);
+		fragment_max = max_size;
+		fragment_delay_us = delay_us;
+	}
+
+	//! Bind to the loopback interface and start the streaming thread
+	bool Start() {
+		if (frames.empty()) {
+			std::cerr << __func__ << ": no frames to stream" << std::endl;
+			return false;
+		}
+		listenfd = socket(AF_INET, SOCK_STREAM, 0);
+		if (listenfd < 0) return false;
+		int reuse = 1;
+		setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+		struct sockaddr_in sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sin_family = AF_INET;
+		sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		sa.sin_port = htons((u_short)port);
+		if (bind(listenfd, (struct sockaddr*)&sa, sizeof(sa)) < 0 || listen(listenfd, 4) < 0) {
+			perror("mjpegserver: bind/listen failed");
+			close(listenfd);
+			listenfd = -1;
+			return false;
+		}
+		socklen_t len = sizeof(sa);
+		getsockname(listenfd, (struct sockaddr*)&sa, &len);
+		port = ntohs(sa.sin_port);
+
+		running = true;
+		if (pthread_create(&thread, NULL, MjpegServer::Run, this) != 0) {
+			running = false;
+			close(listenfd);
+			listenfd = -1;
+			return false;
+		}
+		return true;
+	}
+
+	//! Stop the streaming thread and close all sockets
+	void Stop() {
+		if (!running) return;
+		running = false;
+		pthread_join(thread, NULL);
+		close(listenfd);
+		listenfd = -1;
+	}
+
+	//! The port the server is listening on (only valid after Start)
+	inline int GetPort() { return port; }
+
+	//! The number of frames that have been sent completely to the current client
+	int GetFramesSent() {
+		pthread_mutex_lock(&mutex);
+		int result = frames_sent;
+		pthread_mutex_unlock(&mutex);
+		return result;
+	}
+
+	//! Time (see dobots::get_time_us) at which sending the frame with given index started
+	long long GetSendTime(int frame_number) {
+		long long result = -1;
+		pthread_mutex_lock(&mutex);
+		if (frame_number >= 0 && frame_number < (int)send_times.size())
+			result = send_times[frame_number];
+		pthread_mutex_unlock(&mutex);
+		return result;
+	}
+
+protected:
+	//! Entry point for the thread
+	static void *Run(void *server) {
+		((MjpegServer*)server)->Serve();
+		return NULL;
+	}
+
+	//! Accept clients, one at a time, till the server is stopped
+	void Serve() {
+		while (running) {
+			if (!Wait(listenfd, 100000)) continue;
+			int clientfd = accept(listenfd, NULL, NULL);
+			if (clientfd < 0) continue;
+			pthread_mutex_lock(&mutex);
+			send_times.clear();
+			frames_sent = 0;
+			pthread_mutex_unlock(&mutex);
+			Stream(clientfd);
+			close(clientfd);
+		}
+	}
+
+	/**
+	 * Stream to one client until it disconnects or the server is stopped. The camera only
+	 * needs the first request, so everything the client sends afterwards is just drained.
+	 */
+	void Stream(int clientfd) {
+		char request[4096];
+		while (running && !Wait(clientfd, 100000)) ;
+		if (!running || read(clientfd, request, sizeof(request)) <= 0) return;
+
+		char header[256];
+		long long next = dobots::get_time_us();
+		for (int frame_number = 0; running; ++frame_number) {
+			const std::vector<char> & jpeg = frames[frame_number % frames.size()];
+			int header_size = sprintf(header, "--video boundary--\r\nContent-length: %d\r\n"
+					"X-Frame-Number: %d\r\nContent-type: image/jpeg\r\n\r\n", (int)jpeg.size(), frame_number);
+
+			pthread_mutex_lock(&mutex);
+			send_times.push_back(dobots::get_time_us());
+			pthread_mutex_unlock(&mutex);
+
+			if (!Send(clientfd, header, header_size)) return;
+			if (!Send(clientfd, &jpeg[0], jpeg.size())) return;
+
+			pthread_mutex_lock(&mutex);
+			frames_sent++;
+			pthread_mutex_unlock(&mutex);
+
+			// drain whatever the client sends (it repeats its request for every image)
+			while (Wait(clientfd, 0) && read(clientfd, request, sizeof(request)) > 0) ;
+
+			next += period_us;
+			if (jitter_us) next += (long long)(drand48() * 2 * jitter_us) - jitter_us;
+			long long wait = next - dobots::get_time_us();
+			if (wait > 0) usleep(wait);
+		}
+	}
+
+	//! Write data to the client, in random fragments if so configured
+	bool Send(int clientfd, const char *data, int size) {
+		while (size > 0 && running) {
+			int fragment = size;
+			if (fragment_max) {
+				fragment = fragment_min + (int)(drand48() * (fragment_max - fragment_min + 1));
+				fragment = std::min(fragment, size);
+			}
+			// a client that disconnects should not raise SIGPIPE and kill the process
+			int written = send(clientfd, data, fragment, MSG_NOSIGNAL);
+			if (written <= 0) return false;
+			data += written;
+			size -= written;
+			if (fragment_max && fragment_delay_us) usleep(fragment_delay_us);
+		}
+		return size == 0;
+	}
+
+	//! Wait till there is something to read on the file descriptor (or timeout)
+	bool Wait(int fd, int timeout_us) {
+		fd_set fds;
+		FD_ZERO(&fds);
+		FD_SET(fd, &fds);
+		struct timeval tv;
+		tv.tv_sec = timeout_us / 1000000;
+		tv.tv_usec = timeout_us % 1000000;
+		return select(fd + 1, &fds, NULL, NULL, &tv) > 0;
+	}
+
+private:
+	//! Port to listen on
+	int port;
+
+	//! Socket that accepts connections
+	int listenfd;
+
+	//! The frames to be streamed (in a loop)
+	std::vector<std::vector<char> > frames;
+
+	//! Nominal period between two frames
+	int period_us;
+
+	//! Maximum deviation from the period
+	int jitter_us;
+
+	//! Fragment sizes and delay in between fragments
+	int fragment_min, fragment_max, fragment_delay_us;
+
+	//! Start time of each frame sent to the current client
+	std::vector<long long> send_times;
+
+	//! Number of frames completely sent to the current client
+	int frames_sent;
+
+	//! Thread that serves the clients
+	pthread_t thread;
+
+	//! Protects send_times and frames_sent
+	pthread_mutex_t mutex;
+
+	//! Set to false to stop the thread
+	volatile bool running;
+};
+
+#endif /* MJPEGSERVER_H_ */
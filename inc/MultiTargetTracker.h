@@ -0,0 +1,123 @@
+/**
+ * @brief Track many objects in the same stream of images
+ * @file MultiTargetTracker.h
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 12, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+
+#ifndef MULTITARGETTRACKER_H_
+#define MULTITARGETTRACKER_H_
+
+// General files
+#include <vector>
+
+#include <CImg.h>
+#include <IntegralHistogram.h>
+#include <PositionParticleFilter.h>
+#include <ThreadPool.h>
+
+/* **************************************************************************************
+ * Interface of MultiTargetTracker
+ * **************************************************************************************/
+
+/**
+ * A tracker for many targets in the same images. Every target has its own particle filter with
+ * its own reference histogram, but everything that only depends on the image is done once per
+ * frame: the integral histogram from which all particles of all targets get their histograms.
+ *
+ * A tick runs in three passes over the thread pool: the transitions (a task per target), the
+ * likelihoods of all particles of all targets (in chunks of particles, so a target with many
+ * particles is spread over the threads too), and the resampling (a task per target). Targets that
+ * use a back-projection (see PositionParticleFilter::SetLikelihoodModel and SetMeanShift) get it in
+ * a pass before, once per frame, as it depends on their own histograms.
+ *
+ * Usage:
+ *   SetHistogramConfig, CalcHistogram and AddTarget for every object, Tick for every frame
+ */
+class MultiTargetTracker {
+public:
+	/**
+	 * Constructor.
+	 * @param pool				thread pool to run the passes on (not owned)
+	 * @param chunk_size		number of particles per likelihood task
+	 */
+	MultiTargetTracker(ThreadPool & pool, int chunk_size = 64);
+
+	//! Destructor, deletes the filters of all targets
+	~MultiTargetTracker();
+
+	/**
+	 * Configure the histograms, the same for all targets. Only before the first target is added.
+	 * See PositionParticleFilter::SetHistogramConfig.
+	 */
+	void SetHistogramConfig(int bins, int channels = 1, ChannelMode channel_mode = CM_JOINT);
+
+	//! Calculate the normalized histogram of an image (of an object) with the configuration of the tracker
+	void CalcHistogram(CImg<DataValue> & image, NormalizedHistogramValues & result);
+
+	/**
+	 * Add an object to track.
+	 * @param histogram			histogram of the object, see CalcHistogram
+	 * @param coord				CImg coordinates, careful: picks 0,1 3,4 (skips 2)
+	 * @param particle_count	the number of particles for this object
+	 * @return					the id of the target
+	 */
+	int AddTarget(NormalizedHistogramValues & histogram, CImg<CoordValue> & coord, int particle_count);
+
+	//! Number of targets
+	inline int GetTargetCount() { return targets.size(); }
+
+	//! The filter of a target, for example to get its estimate (see ParticleFilter::GetEstimate)
+	inline PositionParticleFilter *GetTarget(int id) { return targets[id]; }
+
+	/**
+	 * Update all targets with a new image.
+	 * @param img				the image, it should stay around till the next tick
+	 * @param subticks			the number of times this same image needs to be used
+	 */
+	void Tick(CImg<DataValue> *img, int subticks = 1);
+
+	//! The integral histogram of the last image
+	inline const IntegralHistogram & GetIntegralHistogram() const { return *integral; }
+
+private:
+	//! The filters, one per target
+	std::vector<PositionParticleFilter*> targets;
+
+	//! Pool for the passes
+	ThreadPool & pool;
+
+	//! Particles per likelihood task
+	int chunk_size;
+
+	//! Number of bins (per channel)
+	int bins;
+
+	//! Number of colour channels
+	int channels;
+
+	//! Joint or concatenated channels
+	ChannelMode channel_mode;
+
+	//! Histograms of all rectangles of the current image, shared by all targets
+	IntegralHistogram *integral;
+};
+
+#endif /* MULTITARGETTRACKER_H_ */
@@ -33,6 +33,10 @@
 #include <numeric>
 #include <cassert>
 #include <cmath>
+#include <cstdlib>
+#include <set>
+
+#include <boost/random.hpp>
 
 /* **************************************************************************************
  * Interface of ParticleFilter
@@ -176,6 +180,74 @@ private:
 template <typename State>
 class ParticleFilter;
 
+/**
+ * Settings for KLD-sampling, see ParticleFilter::ResampleKLD.
+ */
+struct KLDConfig {
+	enum { MAX_DIMENSION = 8 };
+
+	KLDConfig(): enabled(false), epsilon(0.05), z(2.326), min_count(50), max_count(5000) {
+		std::fill(bin_size, bin_size + MAX_DIMENSION, 1.0);
+	}
+
+	//! Use KLD-sampling in Resample (off by default)
+	bool enabled;
+
+	//! Maximum error, as Kullback-Leibler divergence, between the particles and the true posterior
+	double epsilon;
+
+	//! Upper 1-delta quantile of the standard normal distribution, the error is below epsilon with
+	//! probability 1-delta (2.326 is for delta = 0.01)
+	double z;
+
+	//! Minimum number of particles
+	int min_count;
+
+	//! Maximum number of particles
+	int max_count;
+
+	//! Size of the bins of the state space per value of the state vector (see StateVector)
+	double bin_size[MAX_DIMENSION];
+};
+
+/**
+ * An estimate of the state from the particle cloud, see ParticleFilter::GetEstimate. The state is
+ * seen as a vector of "dimension" values. The estimate has a fixed maximum size, so it can be
+ * filled every tick without allocating anything.
+ */
+struct ParticleEstimate {
+	enum { MAX_DIMENSION = 8 };
+
+	//! Number of values in the state vector
+	int dimension;
+
+	//! Number of particles
+	int count;
+
+	//! Sum of the weights of the particles
+	double total_weight;
+
+	//! Effective number of particles, (sum w)^2 / sum w^2, equal to count if all weights are equal
+	double effective_count;
+
+	//! Weighted mean of the state vectors
+	double mean[MAX_DIMENSION];
+
+	//! Weighted covariance (with normalized weights), row after row of dimension values
+	double covariance[MAX_DIMENSION*MAX_DIMENSION];
+
+	//! State vector of the particle with the highest weight (maximum a posteriori)
+	double map[MAX_DIMENSION];
+
+	//! Weight of that particle
+	double map_weight;
+
+	//! Index of that particle
+	int map_index;
+
+	inline double getCovariance(int i, int j) const { return covariance[i*MAX_DIMENSION+j]; }
+};
+
 /**
  * Add particles to a set, and get them out.
  */
@@ -257,13 +329,32 @@ template <typename State>
 class ParticleFilter {
 public:
 	//! Constructor ParticleFilter
-	ParticleFilter() {}
+	ParticleFilter(): random_number_generator(234789), regularization_bandwidth(0) {}
 
 	//! Destructor ~ParticleFilter
 	virtual ~ParticleFilter() {}
 
-	//! The actual smart part of the particle filter
+	/**
+	 * The actual smart part of the particle filter. With regularization (see SetRegularization) the
+	 * weighted covariance is taken before resampling, and the new particles are moved apart with it
+	 * afterwards.
+	 */
 	void Resample() {
+		bool regularize = regularization_bandwidth > 0 && StateDimension() > 0;
+		if (regularize) GetEstimate(regularization_estimate);
+		if (kld.enabled && StateDimension() > 0) {
+			ResampleKLD();
+		} else {
+			ResampleCopies();
+		}
+		if (regularize) Regularize(regularization_estimate);
+	}
+
+	/**
+	 * Every particle is copied in proportion to its weight, rounded, and the particle with the highest
+	 * weight fills up what is left. The number of particles stays the same.
+	 */
+	void ResampleCopies() {
 		set.Normalize();
 		// sort, with highest weight first
 		std::sort(set.particles.begin(), set.particles.end(), comp_particles<State>);
@@ -277,6 +368,7 @@ public:
 				newN++;
 				if (newN == N) {
 					// now remove old items
+					for (int k = 0; k < N; ++k) delete set.particles[k];
 					set.particles.erase(set.particles.begin(), set.particles.begin()+N);
 					assert ( set.particles.size() == newN);
 					return;
@@ -289,10 +381,217 @@ public:
 			set.particles.push_back(newp);
 			newN++;
 		}
+		for (int k = 0; k < N; ++k) delete set.particles[k];
 		set.particles.erase(set.particles.begin(), set.particles.begin()+N);
 		assert ( set.particles.size() == newN);
 	}
 
+	/**
+	 * Adapt the number of particles to the uncertainty with KLD-sampling (Fox, 2003). Particles are
+	 * drawn according to their weights, one by one, and the state space is cut in bins (see
+	 * KLDConfig::bin_size). Every time a particle falls in a bin that was empty till then, the number
+	 * of particles that is needed goes up: with k occupied bins it is
+	 *   (k-1)/(2 epsilon) * (1 - 2/(9(k-1)) + sqrt(2/(9(k-1))) z)^3
+	 * which bounds the Kullback-Leibler divergence to the true posterior. When the particles are
+	 * concentrated in a few bins, few particles are drawn, when they are spread out, many.
+	 */
+	void ResampleKLD() {
+		int dim = StateDimension();
+		assert (dim > 0 && dim <= KLDConfig::MAX_DIMENSION);
+		std::vector<Particle<State>* > & particles = set.particles;
+		int N = particles.size();
+		if (!N) return;
+		cumulative_weights.resize(N);
+		double total = 0;
+		for (int i = 0; i < N; ++i) {
+			total += particles[i]->getWeight();
+			cumulative_weights[i] = total;
+		}
+
+		boost::uniform_01<boost::mt19937&> uniform(random_number_generator);
+		double vector[KLDConfig::MAX_DIMENSION];
+		occupied_bins.clear();
+		resampled.clear();
+		int k = 0, required = kld.min_count;
+		while ((int)resampled.size() < kld.max_count &&
+				((int)resampled.size() < kld.min_count || (int)resampled.size() < required)) {
+			int i;
+			if (total > 0) {
+				i = std::upper_bound(cumulative_weights.begin(), cumulative_weights.end(), uniform() * total) -
+						cumulative_weights.begin();
+				i = std::min(i, N - 1);
+			} else {
+				i = random_number_generator() % N;
+			}
+			resampled.push_back(particles[i]->clone());
+			StateVector(*particles[i]->getState(), vector);
+			unsigned long long key = 1469598103934665603ULL;
+			for (int d = 0; d < dim; ++d) {
+				long long bin = (long long)std::floor(vector[d] / kld.bin_size[d]);
+				key = (key ^ (unsigned long long)bin) * 1099511628211ULL;
+			}
+			if (occupied_bins.insert(key).second && ++k > 1) {
+				double a = 2.0 / (9.0 * (k - 1));
+				double b = 1.0 - a + std::sqrt(a) * kld.z;
+				required = (int)std::ceil((k - 1) / (2 * kld.epsilon) * b * b * b);
+			}
+		}
+		for (int i = 0; i < N; ++i) delete particles[i];
+		particles.swap(resampled);
+		resampled.clear();
+	}
+
+	//! Configure KLD-sampling, if enabled it replaces the default resampling
+	void SetKLDSampling(const KLDConfig & config) { kld = config; }
+
+	//! Seed the generator of the filter, to give filters that run side by side different random numbers
+	inline void SetSeed(int seed) { random_number_generator.seed(seed); }
+
+	/**
+	 * Turn the filter into a regularized particle filter. After resampling there are a lot of copies
+	 * of the same particles, that only get apart by the noise of Transition. If that noise is small
+	 * the cloud collapses. With regularization every particle is moved by a sample of a Gaussian
+	 * kernel with the covariance of the particles (as it was before resampling), scaled by the
+	 * bandwidth that is optimal for a Gaussian density:
+	 *   h = factor * (4/(d+2))^(1/(d+4)) * N^(-1/(d+4))
+	 * for d values in the state vector and N particles. This needs StateVector and SetStateVector.
+	 * @param factor			multiplies the optimal bandwidth, 0 turns regularization off
+	 */
+	void SetRegularization(double factor = 1.0) {
+		assert (factor >= 0);
+		regularization_bandwidth = factor;
+	}
+
+	/**
+	 * Move all particles by a sample of the kernel with the covariance of the given estimate. The
+	 * Cholesky factor L of the covariance is calculated once, the state vectors are gathered per value
+	 * into one array, so that x += h L e is a set of simple loops over all particles at once, and then
+	 * they are written back. Directions without variance (or that are linear combinations of others)
+	 * are not moved.
+	 */
+	void Regularize(const ParticleEstimate & estimate) {
+		int dim = StateDimension();
+		int N = set.particles.size();
+		assert (dim == estimate.dimension && dim <= ParticleEstimate::MAX_DIMENSION);
+		if (!N || !dim) return;
+		const int stride = ParticleEstimate::MAX_DIMENSION;
+
+		// lower triangular L with L L^T = covariance, semi-definite is allowed
+		double L[ParticleEstimate::MAX_DIMENSION * ParticleEstimate::MAX_DIMENSION];
+		std::fill(L, L + stride * stride, 0.0);
+		for (int j = 0; j < dim; ++j) {
+			double diagonal = estimate.covariance[j*stride+j];
+			for (int k = 0; k < j; ++k) diagonal -= L[j*stride+k] * L[j*stride+k];
+			if (diagonal <= 1e-12 * (1.0 + estimate.covariance[j*stride+j])) continue;
+			L[j*stride+j] = std::sqrt(diagonal);
+			for (int i = j + 1; i < dim; ++i) {
+				double sum = estimate.covariance[i*stride+j];
+				for (int k = 0; k < j; ++k) sum -= L[i*stride+k] * L[j*stride+k];
+				L[i*stride+j] = sum / L[j*stride+j];
+			}
+		}
+		double h = regularization_bandwidth * std::pow(4.0 / (dim + 2), 1.0 / (dim + 4)) *
+				std::pow((double)N, -1.0 / (dim + 4));
+
+		// value i of particle p is at i*N+p, the same for the standard normal samples
+		double vector[ParticleEstimate::MAX_DIMENSION];
+		regularization_values.resize(dim * N);
+		regularization_noise.resize(dim * N);
+		for (int p = 0; p < N; ++p) {
+			StateVector(*set.particles[p]->getState(), vector);
+			for (int i = 0; i < dim; ++i) regularization_values[i*N+p] = vector[i];
+		}
+		boost::uniform_01<boost::mt19937&> uniform(random_number_generator);
+		for (int k = 0; k < dim * N; k += 2) {
+			// Box-Muller, two samples at once
+			double u = 1.0 - uniform(), v = uniform();
+			double r = std::sqrt(-2.0 * std::log(u));
+			regularization_noise[k] = r * std::cos(2 * M_PI * v);
+			if (k + 1 < dim * N) regularization_noise[k+1] = r * std::sin(2 * M_PI * v);
+		}
+		double *values = &regularization_values[0];
+		const double *noise = &regularization_noise[0];
+		for (int i = 0; i < dim; ++i) {
+			for (int j = 0; j <= i; ++j) {
+				double factor = h * L[i*stride+j];
+				if (factor == 0) continue;
+				const double *e = noise + j * N;
+				double *x = values + i * N;
+				for (int p = 0; p < N; ++p) x[p] += factor * e[p];
+			}
+		}
+		for (int p = 0; p < N; ++p) {
+			for (int i = 0; i < dim; ++i) vector[i] = regularization_values[i*N+p];
+			SetStateVector(*set.particles[p]->getState(), vector);
+		}
+	}
+
+	/**
+	 * First stage of the auxiliary particle filter (Pitt and Shephard, 1999), to be followed by
+	 * Transition, Likelihood and AuxiliaryCorrect instead of Transition, Likelihood and Resample.
+	 * The bootstrap filter moves all particles and only then sees which ones ended up at the right
+	 * place. For a fast moving object most of them do not. The auxiliary filter looks ahead first:
+	 * every particle gets the cheap likelihood of where it is expected to go (see LookAhead) times
+	 * its weight, and the particles are resampled with these weights, systematically, before they
+	 * move. The particles should have the weights of the previous AuxiliaryCorrect, or all zero
+	 * (just after initialisation), in which case they count equally.
+	 */
+	void AuxiliarySelect() {
+		std::vector<Particle<State>* > & particles = set.particles;
+		int N = particles.size();
+		if (!N) return;
+		double total_weight = 0;
+		for (int i = 0; i < N; ++i) total_weight += particles[i]->getWeight();
+		look_ahead.resize(N);
+		cumulative_weights.resize(N);
+		double total = 0;
+		for (int i = 0; i < N; ++i) {
+			look_ahead[i] = LookAhead(*particles[i]->getState());
+			total += (total_weight > 0 ? particles[i]->getWeight() : 1.0) * look_ahead[i];
+			cumulative_weights[i] = total;
+		}
+		if (total <= 0) {
+			// nothing looks good, keep the particles as they are
+			std::fill(look_ahead.begin(), look_ahead.end(), 1.0);
+			return;
+		}
+		resampled.clear();
+		first_stage.resize(N);
+		boost::uniform_01<boost::mt19937&> uniform(random_number_generator);
+		double step = total / N, u = uniform() * step;
+		for (int i = 0, j = 0; j < N; ++j, u += step) {
+			while (i < N - 1 && cumulative_weights[i] <= u) ++i;
+			resampled.push_back(particles[i]->clone());
+			first_stage[j] = look_ahead[i];
+		}
+		for (int i = 0; i < N; ++i) delete particles[i];
+		particles.swap(resampled);
+		resampled.clear();
+		look_ahead.swap(first_stage);
+	}
+
+	/**
+	 * Second stage of the auxiliary particle filter, after Likelihood: the weights are divided by the
+	 * look-ahead likelihood of the particle they were copied from, so that the particles are weighted
+	 * according to the true posterior again. The particles must be in the same order as after
+	 * AuxiliarySelect.
+	 */
+	void AuxiliaryCorrect() {
+		std::vector<Particle<State>* > & particles = set.particles;
+		assert (look_ahead.size() == particles.size());
+		for (size_t i = 0; i < particles.size(); ++i) {
+			if (look_ahead[i] > 0) particles[i]->setWeight(particles[i]->getWeight() / look_ahead[i]);
+		}
+	}
+
+	/**
+	 * The first-stage likelihood of the auxiliary particle filter: how likely the observation is at
+	 * the position a particle is expected to move to (without noise). This should be much cheaper than
+	 * the Likelihood of a particle, an approximation is fine, it only makes the particles go where
+	 * they are needed. The default does not look ahead at all.
+	 */
+	virtual double LookAhead(State & /*state*/) { return 1.0; }
+
 	//! Transition according to a certain model
 	virtual void Transition() = 0;
 
@@ -301,14 +600,178 @@ public:
 	//! This function should calculate this for all particles and update weights accordingly
 	virtual void Likelihood() = 0;
 
+	//! Number of particles
+	inline int GetParticleCount() { return set.particles.size(); }
+
+	//! Number of values in the state vector of a particle, 0 if there is none (see StateVector)
+	virtual int StateDimension() { return 0; }
+
+	//! Write the state of a particle as StateDimension() values, used for the estimates
+	virtual void StateVector(State & /*state*/, double * /*vector*/) { }
+
+	//! Set the state of a particle from StateDimension() values, the reverse of StateVector
+	virtual void SetStateVector(State & /*state*/, const double * /*vector*/) { }
+
+	/**
+	 * Estimate the state by the weighted mean and covariance of the particles, and the particle with
+	 * the highest weight. All of it is calculated in one pass over the particles, without sorting
+	 * them (with the weighted incremental algorithm of West for mean and covariance). The weights do
+	 * not need to be normalized. If all weights are zero, as they are just after Resample, all
+	 * particles count equally.
+	 */
+	void GetEstimate(ParticleEstimate & estimate) {
+		int dim = StateDimension();
+		assert (dim <= ParticleEstimate::MAX_DIMENSION);
+		estimate.dimension = dim;
+		estimate.count = set.particles.size();
+		if (!CalcEstimate(estimate, false))
+			CalcEstimate(estimate, true);
+	}
+
+	/**
+	 * The weighted quantile of one of the values of the state vector: the smallest value for which
+	 * the weight of the particles with that value or less is at least fraction q of the total. This
+	 * uses selection (std::nth_element) on halving ranges, which takes linear time on average.
+	 * @param dimension			index in the state vector
+	 * @param q					the fraction, e.g. 0.5 for the weighted median
+	 * @return					the quantile, 0 if there are no particles
+	 */
+	double GetQuantile(int dimension, double q) {
+		int dim = StateDimension();
+		assert (dimension >= 0 && dimension < dim && dim <= ParticleEstimate::MAX_DIMENSION);
+		int n = set.particles.size();
+		if (!n) return 0;
+		double vector[ParticleEstimate::MAX_DIMENSION];
+		quantile_values.resize(n);
+		double total = 0;
+		for (int i = 0; i < n; ++i) {
+			StateVector(*set.particles[i]->getState(), vector);
+			quantile_values[i].first = vector[dimension];
+			quantile_values[i].second = set.particles[i]->getWeight();
+			total += quantile_values[i].second;
+		}
+		if (total <= 0) {
+			for (int i = 0; i < n; ++i) quantile_values[i].second = 1;
+			total = n;
+		}
+		double target = q * total;
+		double below = 0; // weight of everything left of lo
+		int lo = 0, hi = n;
+		while (lo < hi) {
+			int mid = (lo + hi) / 2;
+			std::nth_element(quantile_values.begin() + lo, quantile_values.begin() + mid, quantile_values.begin() + hi);
+			double left = 0;
+			for (int i = lo; i < mid; ++i) left += quantile_values[i].second;
+			if (mid > lo && below + left >= target) {
+				hi = mid;
+			} else if (below + left + quantile_values[mid].second >= target) {
+				return quantile_values[mid].first;
+			} else {
+				below += left + quantile_values[mid].second;
+				lo = mid + 1;
+			}
+		}
+		// only by rounding errors for q = 1
+		return std::max_element(quantile_values.begin(), quantile_values.end())->first;
+	}
+
 protected:
 	//! Hand over access to particles to subclasses
 	std::vector<Particle<State>* >& getParticles() { return set.particles; }
 
+	/**
+	 * Own generator for resampling and for the noise in subclasses, instead of the global one of
+	 * drand48, so filters can run in parallel and are reproducible with SetSeed.
+	 */
+	boost::mt19937 random_number_generator;
+
+	/**
+	 * The pass over the particles for GetEstimate, with their weights or all with weight one. Returns
+	 * false if the total weight is zero.
+	 */
+	bool CalcEstimate(ParticleEstimate & estimate, bool uniform) {
+		int dim = estimate.dimension;
+		const int stride = ParticleEstimate::MAX_DIMENSION;
+		double vector[ParticleEstimate::MAX_DIMENSION];
+		double delta[ParticleEstimate::MAX_DIMENSION];
+		std::fill(estimate.mean, estimate.mean + stride, 0.0);
+		std::fill(estimate.covariance, estimate.covariance + stride * stride, 0.0);
+		std::fill(estimate.map, estimate.map + stride, 0.0);
+		estimate.map_weight = 0;
+		estimate.map_index = -1;
+		double total = 0, total_squared = 0;
+		for (int p = 0; p < estimate.count; ++p) {
+			double w = uniform ? 1.0 : set.particles[p]->getWeight();
+			if (w <= 0) continue;
+			StateVector(*set.particles[p]->getState(), vector);
+			if (w > estimate.map_weight) {
+				estimate.map_weight = w;
+				estimate.map_index = p;
+				std::copy(vector, vector + dim, estimate.map);
+			}
+			total += w;
+			total_squared += w * w;
+			double r = w / total;
+			for (int i = 0; i < dim; ++i) {
+				delta[i] = vector[i] - estimate.mean[i];
+				estimate.mean[i] += r * delta[i];
+			}
+			// sum of w (x - mean_old)(x - mean_new)
+			for (int i = 0; i < dim; ++i) {
+				double d = w * (vector[i] - estimate.mean[i]);
+				for (int j = 0; j < dim; ++j)
+					estimate.covariance[j*stride+i] += delta[j] * d;
+			}
+		}
+		estimate.total_weight = uniform ? 0 : total;
+		if (total <= 0) {
+			estimate.effective_count = 0;
+			return false;
+		}
+		for (int i = 0; i < dim; ++i)
+			for (int j = 0; j < dim; ++j)
+				estimate.covariance[i*stride+j] /= total;
+		estimate.effective_count = total * total / total_squared;
+		return true;
+	}
+
 private:
 
 	//! The actual cloud of particles
 	ParticleSet<State> set;
+
+	//! Space for GetQuantile, to avoid allocations every call
+	std::vector<std::pair<double, double> > quantile_values;
+
+	//! Settings for KLD-sampling
+	KLDConfig kld;
+
+	//! Space for ResampleKLD: running sum of the weights
+	std::vector<double> cumulative_weights;
+
+	//! Space for ResampleKLD: the bins with at least one particle
+	std::set<unsigned long long> occupied_bins;
+
+	//! Space for ResampleKLD: the new particles
+	std::vector<Particle<State>* > resampled;
+
+	//! Factor for the bandwidth of the regularization kernel, 0 if it is off
+	double regularization_bandwidth;
+
+	//! The estimate before resampling, for the regularization
+	ParticleEstimate regularization_estimate;
+
+	//! Space for Regularize: the state vectors of all particles, per value
+	std::vector<double> regularization_values;
+
+	//! Space for Regularize: standard normal samples, the same layout
+	std::vector<double> regularization_noise;
+
+	//! Per particle, the look-ahead likelihood of the particle it was copied from by AuxiliarySelect
+	std::vector<double> look_ahead;
+
+	//! Space for AuxiliarySelect
+	std::vector<double> first_stage;
 };
 
 #endif /* PARTICLEFILTER_HPP_ */
@@ -29,8 +29,13 @@
 #include <CImg.h>
 
 #include <Histogram.h>
+#include <IntegralHistogram.h>
+#include <BackProjection.h>
 #include <Container.hpp>
 #include <Autoregression.hpp>
+#include <Frame.h>
+#include <LatencyHistogram.h>
+#include <ThreadPool.h>
 
 #include <algorithm>
 #include <cassert>
@@ -49,6 +54,66 @@ struct RegionSize {
 	int height;
 };
 
+/**
+ * Settings for a coarse-to-fine search for the tracked object over the entire image, see
+ * PositionParticleFilter::ScanLikelihoods.
+ */
+struct ScanConfig {
+	ScanConfig(): coarse_step(16), fine_step(4), threshold(0.5), tile_size(128), pool(NULL), deadline(0) {}
+
+	//! Distance in pixels between the positions of the coarse grid
+	int coarse_step;
+
+	//! Distance in pixels between the positions around promising coarse positions
+	int fine_step;
+
+	//! Coarse positions with at least this fraction of the best coarse likelihood are refined
+	float threshold;
+
+	//! The image is cut in square tiles of this size (in pixels) that are evaluated in parallel
+	int tile_size;
+
+	//! Pool to evaluate the tiles on (not owned), if NULL all is done in the calling thread
+	ThreadPool *pool;
+
+	//! Time (see dobots::get_time_us) after which positions are not evaluated anymore, 0 for none
+	long long deadline;
+};
+
+/**
+ * How a rectangle of the image is compared with the object, see
+ * PositionParticleFilter::SetLikelihoodModel.
+ */
+enum LikelihoodModel {
+	//! Distance between the histogram of the rectangle and the one of the object
+	LM_HISTOGRAM,
+	//! Mean weight of the pixels of the rectangle in the back-projection of the object histogram
+	LM_BACKPROJECTION
+};
+
+/**
+ * When to consider the track to be lost and how to search for the object again, see
+ * PositionParticleFilter::SetRedetection.
+ */
+struct RedetectConfig {
+	RedetectConfig(): enabled(false), min_likelihood(0.001), min_effective_ratio(0), time_budget(20000) {}
+
+	//! Search the object again if the track is lost (off by default)
+	bool enabled;
+
+	//! The track is lost if no particle has at least this likelihood
+	float min_likelihood;
+
+	//! The track is also lost if the effective number of particles falls below this fraction of them
+	float min_effective_ratio;
+
+	//! Maximum time for the search (in microseconds)
+	long long time_budget;
+
+	//! Grid and thread pool for the search, the coarse grid is made coarser to fit in the time budget
+	ScanConfig scan;
+};
+
 static int ParticleStateId = 0;
 
 /**
@@ -160,6 +225,18 @@ public:
 	 */
 	void Tick(CImg<DataValue> *img_frame, int subticks = 1);
 
+	/**
+	 * Tick with a frame from an image source. The receive time of the frame is used to adapt the
+	 * motion model to the time between frames and to measure the latency of the estimate.
+	 */
+	void Tick(Frame<CImg<DataValue> > &frame, int subticks = 1);
+
+	//! Latencies from receiving a frame till having its estimate, only for Tick with a frame
+	inline const LatencyHistogram & GetLatency() const { return latency; }
+
+	//! Latency of the last frame (in microseconds)
+	inline long long GetLastLatency() const { return last_latency; }
+
 	/**
 	 * Initialize particle cloud.
 	 * @param tracked_object_histogram		histogram of the entity that needs to be tracked
@@ -184,16 +261,188 @@ public:
 	 */
 	void Likelihood();
 
+	/**
+	 * Calculate the likelihood of the particles with index [first,last) and set their weights.
+	 * Can be called in parallel for different ranges.
+	 */
+	void Likelihood(int first, int last);
+
+	/**
+	 * Use the histograms of an integral histogram of the current image instead of calculating
+	 * them from the pixels for every particle. The integral histogram should have the same
+	 * configuration as this filter (see SetHistogramConfig). It is not owned, NULL to stop using it.
+	 */
+	inline void SetIntegralHistogram(IntegralHistogram *integral) { this->integral = integral; }
+
+	//! Set the image for Transition and Likelihood, normally done by Tick
+	inline void SetImage(CImg<DataValue> *image) { img = image; }
+
+	/**
+	 * Configure how the scale of the rectangles of the particles changes. The scale follows the same
+	 * AR(2) model as the position, with white noise of the given variance. It is kept within bounds,
+	 * so a rectangle does not degenerate into a pixel or cover much more than the image. With an
+	 * integral histogram (see SetIntegralHistogram) the likelihood costs the same for every scale.
+	 * To keep the rectangle from shrinking within the object, the likelihood also compares a ring
+	 * around the rectangle, which should look different from the object. This is only done with an
+	 * integral histogram or the back-projection (see SetLikelihoodModel), cropping the ring from the
+	 * image would double the cost of every particle. Without them the scale stays fixed (see
+	 * IsScaleLive), as nothing would keep it from drifting.
+	 * @param variance			noise of the scale per tick (0.001 by default)
+	 * @param min_scale			smallest scale (0.1 by default)
+	 * @param max_scale			largest scale (4 by default)
+	 * @param context			width of the ring as a fraction of the rectangle (0.25 by default),
+	 * 							0 to only compare the rectangle
+	 */
+	void SetScaleModel(Value variance, Value min_scale = 0.1, Value max_scale = 4.0, Value context = 0.25);
+
+	//! The scale is estimated only if the ring can be compared cheaply, see SetScaleModel
+	inline bool IsScaleLive() const {
+		return integral != NULL || likelihood_model == LM_BACKPROJECTION;
+	}
+
+	/**
+	 * Let Tick run the auxiliary particle filter (see ParticleFilter::AuxiliarySelect) instead of
+	 * Transition, Likelihood and Resample. The look-ahead likelihood is the histogram distance at the
+	 * predicted position of a particle, on an integral histogram of the image subsampled by the given
+	 * factor, so it costs a fraction of the full likelihood. With 0 it is off (the default).
+	 */
+	void SetAuxiliary(int subsample = 4);
+
+	//! Likelihood at the position a particle is expected to move to, on the subsampled image
+	double LookAhead(ParticleState & state);
+
+	/**
+	 * Let Tick move every particle uphill after Transition, with a few iterations of mean-shift on the
+	 * back-projection of the histogram of the object on the image (see BackProjection), as in the
+	 * Mean Shift Embedded Particle Filter (Shan, Tan, Wei). The back-projection is calculated once
+	 * per frame. The particles end up close to the object, so far fewer of them are needed. With 0
+	 * iterations it is off (the default).
+	 */
+	void SetMeanShift(int iterations = 3);
+
+	//! Move all particles with mean-shift on the back-projection of the current image
+	void MeanShift();
+
+	/**
+	 * Choose how the likelihood of a particle is calculated. With LM_HISTOGRAM (the default) the
+	 * histogram of the rectangle of a particle is compared with the one of the object. With
+	 * LM_BACKPROJECTION every pixel of the image is given a weight once per frame, by a table per
+	 * colour channel (see BackProjection), and the likelihood follows from the mean weight of the
+	 * rectangle: four lookups in a summed-area table, for any rectangle and any number of bins. It
+	 * looks at pixels one by one instead of at the distribution of colours, so it is less
+	 * discriminative. Its values are lower than those of LM_HISTOGRAM, the thresholds of the
+	 * redetection might need to be adapted. In both cases the ring around the rectangle is compared
+	 * too (see SetScaleModel).
+	 */
+	void SetLikelihoodModel(LikelihoodModel model);
+
+	//! Calculate the back-projection on the current image if it is needed, normally done by Tick
+	void CalcBackProjection();
+
 	/**
 	 * Return particles, or more specific, return the coordinates of the particles, ordered
-	 * on weight.
+	 * on weight. The caller has to delete the coordinates, use GetParticleRectangles to
+	 * avoid an allocation per particle.
 	 */
 	void GetParticleCoordinates(std::vector<CImg<CoordValue> *> & coordinates);
 
+	/**
+	 * Write the rectangles of the particles with the highest weights in a buffer provided by the
+	 * caller, highest weight first. Only these particles are sorted (with std::partial_sort).
+	 * @param rectangles					buffer for 4 values per rectangle: left, top, right, bottom
+	 * @param max_count						maximum number of rectangles (the buffer should hold
+	 * 										4*max_count values)
+	 * @return								the number of rectangles written
+	 */
+	int GetParticleRectangles(CoordValue *rectangles, int max_count);
+
+	//! The state vector is x, y, and scale (see ParticleFilter::GetEstimate)
+	int StateDimension() { return 3; }
+
+	//! The current x, y, and scale of a particle
+	void StateVector(ParticleState & state, double *vector);
+
+	//! Move a particle to x, y, and scale, its history is moved along so its velocity stays the same
+	void SetStateVector(ParticleState & state, const double *vector);
+
+	/**
+	 * Configure the histograms that are compared, call before Init. By default only the first
+	 * channel (red) is used, with 16 bins. For colour tracking use, for example, 8 bins and 3
+	 * joint channels (512 bins in total), or 16 bins and 3 concatenated channels (48 bins).
+	 */
+	void SetHistogramConfig(int bins, int channels = 1, ChannelMode channel_mode = CM_JOINT);
+
+	/**
+	 * Calculate the normalized histogram of an image with the configuration of this filter. Use
+	 * this for the histogram of the object to be tracked that is given to Init.
+	 */
+	void CalcHistogram(CImg<DataValue> & image, NormalizedHistogramValues & result);
+
 	/**
 	 * Return the likelihood of the histogram at all possible positions.
 	 */
 	void GetLikelihoods(CImg<DataValue> & result, RegionSize region_size, int block_size = 8);
+
+	/**
+	 * Return the likelihood of the histogram over the image, calculated coarse-to-fine with
+	 * ScanLikelihoods, in the same form as the function above.
+	 */
+	void GetLikelihoods(CImg<DataValue> & result, RegionSize region_size, const ScanConfig & config);
+
+	/**
+	 * Search the tracked object in the entire image of the last tick. The likelihood is calculated
+	 * on a coarse grid first, and only around the positions with a likelihood close to the best one
+	 * on a fine grid. The image is cut in tiles which are evaluated in parallel if there is a pool.
+	 * @param map			likelihood per block of fine_step by fine_step pixels, where only the coarse
+	 * 						grid has been evaluated the block has the value of the nearest coarse position
+	 * @param region_size	the rectangle over which to match the histograms
+	 * @param config		grid sizes, threshold, and thread pool
+	 * @param best_x		horizontal centre of the best position
+	 * @param best_y		vertical centre of the best position
+	 * @return				the likelihood at the best position, 0 if the image is too small
+	 */
+	float ScanLikelihoods(CImg<float> & map, RegionSize region_size, const ScanConfig & config,
+			int & best_x, int & best_y);
+
+	/**
+	 * Calculate the likelihood of positions [begin,end) of a list of positions, stored as x,y pairs.
+	 * Can be called in parallel for different ranges. After the deadline (if not 0) the remaining
+	 * positions are skipped, their likelihood stays 0.
+	 */
+	void CalcLikelihoods(RegionSize region_size, const std::vector<int> & positions,
+			std::vector<float> & likelihoods, int begin, int end, long long deadline = 0);
+
+	/**
+	 * Configure what to do when the track is lost. If enabled, every tick checks after the likelihoods
+	 * of the particles have been calculated if the track is lost, and if so, the object is searched in
+	 * the entire image (see ScanLikelihoods) and all particles are put at the best position found.
+	 */
+	void SetRedetection(const RedetectConfig & config) { redetect_config = config; }
+
+	/**
+	 * The track is lost if the weights of the particles are below the thresholds of the redetection
+	 * configuration. Only meaningful after the likelihoods have been calculated and before resampling.
+	 */
+	bool IsLost();
+
+	/**
+	 * If redetection is enabled and the track is lost, search the object again (called by Tick between
+	 * the likelihoods and resampling).
+	 */
+	void CheckLost();
+
+	/**
+	 * Search the object in the entire image within the time budget and reseed the particles if a better
+	 * position is found than the best particle.
+	 * @return				true if the particles have been reseeded
+	 */
+	bool Redetect();
+
+	//! Number of times the track has been lost
+	inline int GetLostCount() const { return lost_count; }
+
+	//! Number of times the particles have been reseeded by Redetect
+	inline int GetReseedCount() const { return reseed_count; }
 protected:
 
 	/**
@@ -207,9 +456,15 @@ protected:
 	float Likelihood(ParticleState & state);
 
 private:
-	//! The number of bins
+	//! The number of bins (per channel)
 	int bins;
 
+	//! The number of colour channels used for the histograms
+	int channels;
+
+	//! Joint or concatenated colour channels
+	ChannelMode channel_mode;
+
 	//! The histogram of the object to be tracked
 	NormalizedHistogramValues tracked_object_histogram;
 
@@ -219,12 +474,77 @@ private:
 	//! Image to get data from
 	CImg<DataValue> * img;
 
+	//! Integral histogram of img, if not NULL it is used for the histograms of the particles
+	IntegralHistogram *integral;
+
 	//! Seed for random number generator
 	int seed;
 
 	//! See http://demonstrations.wolfram.com/AutoRegressiveSimulationSecondOrder/
 	std::vector<Value> auto_coeff;
 
+	//! Noise of the scale in the motion model
+	Value scale_variance;
+
+	//! Bounds of the scale
+	Value min_scale, max_scale;
+
+	//! Width of the ring around a rectangle that is compared too, relative to the rectangle
+	Value scale_context;
+
+	//! The histogram of a rectangle from an integral histogram, or from the image if it is NULL,
+	//! returns the number of pixels it is over
+	int RegionHistogram(const IntegralHistogram *source, int x0, int y0, int x1, int y1,
+			NormalizedHistogramValues & result);
+
+	//! The likelihood of the object in a rectangle (centre and size) of the image or of an integral histogram
+	float Likelihood(const IntegralHistogram *source, Value x, Value y, Value width, Value height);
+
+	//! Receive time of the previous frame, 0 if there has not been one
+	long long last_receive_time;
+
+	//! Time per subtick between the previous frame and the one before (in microseconds)
+	long long last_step;
+
+	//! Latency statistics
+	LatencyHistogram latency;
+
+	//! Latency of the last frame
+	long long last_latency;
+
+	//! When and how to search the object again
+	RedetectConfig redetect_config;
+
+	//! Number of ticks in which the track was lost
+	int lost_count;
+
+	//! Number of times the particles have been reseeded
+	int reseed_count;
+
+	//! Subsample factor of the image for the auxiliary particle filter, 0 if it is off
+	int aux_subsample;
+
+	//! Integral histogram of the subsampled image, for LookAhead (owned, created when needed)
+	IntegralHistogram *lowres_integral;
+
+	//! The subsampled image
+	CImg<DataValue> lowres_image;
+
+	//! Subsample the image and calculate its integral histogram
+	void CalcLookAhead();
+
+	//! Number of mean-shift iterations after Transition, 0 if it is off
+	int mean_shift_iterations;
+
+	//! Back-projection of the histogram of the object on the current image (owned, created when needed)
+	BackProjection *backprojection;
+
+	//! How the likelihood of a particle is calculated
+	LikelihoodModel likelihood_model;
+
+	//! The likelihood of the object in a rectangle (centre and size) with the back-projection
+	float BackProjectionLikelihood(Value x, Value y, Value width, Value height);
+
 
 };
 
@@ -31,8 +31,8 @@
 
 #include <Config.h>
 
-//! Remove joint probability calculations, which saves a lot on memory requirements
-#define CALC_JOINTFREQ 0
+//! Joint probability calculations, only the time series of bins is stored (see JointFrequencies)
+#define CALC_JOINTFREQ 1
 
 /* **************************************************************************************
  * Configuration option consequences
@@ -60,6 +60,8 @@
 // General files
 #include <vector>
 
+#include <JointFrequencies.h>
+
 /* **************************************************************************************
  * General data types/formats
  * **************************************************************************************/
@@ -81,6 +83,23 @@ typedef unsigned char DataValue;
  */
 typedef int HistogramValue;
 
+/**
+ * A histogram can be calculated per pixel over time (HM_PER_PIXEL), which is what Crutchfield
+ * needs to compare pixels with each other, or over all pixels at once (HM_GLOBAL), which is all
+ * that is needed for comparing image regions, such as in the particle filter. The latter
+ * only requires a single row of bins instead of one for every pixel.
+ */
+enum HistogramMode { HM_PER_PIXEL, HM_GLOBAL };
+
+/**
+ * Colour images are stored by CImg as planes: first all red values, then all green values,
+ * etc. A global histogram can be calculated over multiple of these planes (channels):
+ *  - CM_JOINT, one bin per combination, e.g. 8x8x8 = 512 bins for RGB
+ *  - CM_CONCATENATED, one histogram per channel, put one after the other, e.g. 3x16 = 48 bins
+ * In both cases the bins of the result are contiguous, channel 0 varying fastest for joint bins.
+ */
+enum ChannelMode { CM_JOINT, CM_CONCATENATED };
+
 /**
  * The data is just represented as a big char/float/double vector. To remember the fact
  * that it is already a pointer to a series of values, it gets the prefix "p". It can just
@@ -107,7 +126,7 @@ typedef std::vector<pDataMatrix> DataFrames;
 class ProbMatrix {
 public:
 	//! Constructor ProbMatrix
-	ProbMatrix(int bins, int width, int height);
+	ProbMatrix(int bins, int width, int height, HistogramMode mode = HM_PER_PIXEL);
 
 	//! Destructor ~ProbMatrix
 	virtual ~ProbMatrix();
@@ -133,7 +152,22 @@ public:
 	inline int getBins() { return bins; }
 
 	//! Set number of bins
-	inline void setBins(int bins) { this->bins = bins; bins_squared = bins*bins; }
+	inline void setBins(int bins) { this->bins = bins; bins_squared = bins*bins; calcBinTable(); }
+
+	//! Get the way frequencies are counted
+	inline HistogramMode getMode() { return mode; }
+
+	/**
+	 * Use multiple channels (planes of p_size values each) of the data frames, only for HM_GLOBAL
+	 * mode. The number of bins is per channel.
+	 */
+	void setChannels(int channels, ChannelMode channel_mode = CM_JOINT);
+
+	//! Get number of channels
+	inline int getChannels() { return channels; }
+
+	//! Number of values in the resulting histogram (depends on bins, channels, and channel mode)
+	int getHistogramSize();
 
 	//! Get joint probability for pixel p0 and p1 in state bin0 and bin1
 	//! Try to use getJointFrequency instead and divide by time_len as
@@ -150,23 +184,19 @@ public:
 	 * If you really want to use probabilities, use getJointProbability instead (which of course will use
 	 * the previously set number of frames from the calculations before).
 	 *
-	 * The getJointFrequency function just returns values that are already pre-calculated. Each time
-	 * the input changes, you will have to call calcProbabilities first.
+	 * The getJointFrequency function returns values that are calculated (in blocks of pixel pairs)
+	 * from the binned data stored by calcProbabilities. Each time the input changes, you will have
+	 * to call calcProbabilities first.
 	 */
 	HistogramValue getJointFrequency(int p0, int bin0, int p1, int bin1) {
 		CHECK_JOINTFREQ;
-		if (p0 == p1) return 0;
-		if (p0 < p1) { // swap, only upper triangle of matrix is filled, because it is symmetric
-			int temp = p0; p0 = p1; p1 = temp;
-			temp = bin0; bin0 = bin1; bin1 = temp;
-		}
-		// get offset for joint freq vector for (p0,p1)
-		// p_size is needed for row size estimation
-		int m = p0*bins_squared + p1*bins_squared*p_size;
-		return joint_freq[m+bin0+bins*bin1];
+		return joint_freq->getJointFrequency(p0, bin0, p1, bin1);
 	}
 
 protected:
+	//! Fill the lookup table from (8-bit) values to bins
+	void calcBinTable();
+
 	//! Number of bins
 	int bins;
 
@@ -185,8 +215,26 @@ protected:
 	//! Probability (or actually frequency) matrix
 	HistogramValue *freq;
 
-	//! Joint probability (or actually frequency) matrix
-	HistogramValue *joint_freq;
+	//! Joint probability (or actually frequency) matrix, calculated on request
+	JointFrequencies *joint_freq;
+
+	//! Frequencies over all pixels (only in HM_GLOBAL mode, freq is not used then)
+	HistogramValue *global_freq;
+
+	//! Per-pixel or global histogram
+	HistogramMode mode;
+
+	//! Bin for each possible 8-bit value
+	int bin_table[256];
+
+	//! Number of channels
+	int channels;
+
+	//! Joint or concatenated channels
+	ChannelMode channel_mode;
+
+	//! Index in the histogram per channel and 8-bit value (channel*256+value), see setChannels
+	std::vector<int> channel_table;
 
 	//! Number of frames
 	int frame_count;
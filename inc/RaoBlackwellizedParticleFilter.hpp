@@ -0,0 +1,268 @@
+/**
+ * @brief A particle filter that samples positions and tracks velocities with Kalman filters
+ * @file RaoBlackwellizedParticleFilter.hpp
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 18, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+
+#ifndef RAOBLACKWELLIZEDPARTICLEFILTER_HPP_
+#define RAOBLACKWELLIZEDPARTICLEFILTER_HPP_
+
+// General files
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include <boost/random.hpp>
+#include <boost/random/normal_distribution.hpp>
+
+/* **************************************************************************************
+ * Interface of RaoBlackwellizedParticleFilter
+ * **************************************************************************************/
+
+/**
+ * A Rao-Blackwellized particle filter for D values (for example x, y and scale) that each move
+ * with a velocity. Only the values are sampled. Given the sampled path of a particle, its velocity
+ * is linear-Gaussian, so it is tracked exactly by a Kalman filter per particle and per value:
+ *   v[n] = v[n-1] + N(0,q)
+ *   p[n] = p[n-1] + v[n-1] + N(0,r)
+ * The particles do not have to cover all velocities anymore, only the positions, so far less
+ * particles are needed than with the AR(2) model of PositionParticleFilter, where the velocity is
+ * in the history of the samples.
+ *
+ * A step of a particle, per value:
+ * - sample p[n] from N(p[n-1] + m, P + r), with the velocity marginalized out
+ * - update the Kalman filter with the step p[n] - p[n-1], which is a measurement of v[n-1]
+ * - predict the velocity for the next step, the variance grows with q
+ * - weigh the particle with the likelihood of p[n] (implemented by the subclass)
+ *
+ * Everything is stored per value over all particles (structure of arrays), not per particle.
+ * The steps are then loops over plain arrays, and resampling moves numbers instead of objects.
+ *
+ * Usage:
+ *   Init, then for every observation Tick (or Transition, Likelihood and Resample), GetEstimate
+ */
+template <int D>
+class RaoBlackwellizedParticleFilter {
+public:
+	//! Constructor with the seed for the noise
+	RaoBlackwellizedParticleFilter(int seed = 234789): random_number_generator(seed) {
+		std::fill(position_noise, position_noise + D, 1.0);
+		std::fill(velocity_noise, velocity_noise + D, 0.1);
+	}
+
+	//! Destructor ~RaoBlackwellizedParticleFilter
+	virtual ~RaoBlackwellizedParticleFilter() {}
+
+	/**
+	 * Set the variances of the noise on one of the values.
+	 * @param d					index of the value
+	 * @param position			variance r of the noise on the position, per step
+	 * @param velocity			variance q of the change of the velocity, per step
+	 */
+	void SetNoise(int d, double position, double velocity) {
+		assert (d >= 0 && d < D && position > 0 && velocity >= 0);
+		position_noise[d] = position;
+		velocity_noise[d] = velocity;
+	}
+
+	/**
+	 * All particles start at the given position with velocity zero, of which the uncertainty is
+	 * given by its variance.
+	 * @param start				D values
+	 * @param particle_count	number of particles
+	 * @param velocity_variance	variance of the velocity at the start, per value
+	 */
+	void Init(const double *start, int particle_count, double velocity_variance = 1.0) {
+		assert (particle_count > 0 && velocity_variance >= 0);
+		for (int d = 0; d < D; ++d) {
+			position[d].assign(particle_count, start[d]);
+			velocity[d].assign(particle_count, 0.0);
+			variance[d].assign(particle_count, velocity_variance);
+		}
+		weight.assign(particle_count, 1.0 / particle_count);
+	}
+
+	//! Transition, Likelihood and Resample, subticks times
+	void Tick(int subticks = 1) {
+		assert (subticks > 0);
+		for (int i = 0; i < subticks; ++i) {
+			Transition();
+			Likelihood();
+			Resample();
+		}
+	}
+
+	/**
+	 * Sample the new positions and update the Kalman filters of the velocities. The noise is drawn
+	 * first for all particles, so the rest is arithmetic over arrays.
+	 */
+	void Transition() {
+		int N = weight.size();
+		boost::normal_distribution<> normal_dist(0.0, 1.0);
+		boost::variate_generator<boost::mt19937&, boost::normal_distribution<> > epsilon(
+				random_number_generator, normal_dist);
+		noise.resize(N);
+		for (int d = 0; d < D; ++d) {
+			for (int i = 0; i < N; ++i) noise[i] = epsilon();
+			double r = position_noise[d], q = velocity_noise[d];
+			double *p = &position[d][0], *m = &velocity[d][0], *P = &variance[d][0];
+			for (int i = 0; i < N; ++i) {
+				double s = P[i] + r;
+				double innovation = std::sqrt(s) * noise[i];
+				double gain = P[i] / s;
+				p[i] += m[i] + innovation;
+				m[i] += gain * innovation;
+				P[i] = (1 - gain) * P[i] + q;
+			}
+		}
+	}
+
+	//! Set the weight of every particle to the likelihood of its position
+	void Likelihood() {
+		Likelihood(0, weight.size());
+	}
+
+	/**
+	 * Set the weights of the particles [first,last) to the likelihood of their positions. Can be
+	 * called in parallel for different ranges.
+	 */
+	void Likelihood(int first, int last) {
+		assert (first >= 0 && last <= (int)weight.size());
+		double values[D];
+		for (int i = first; i < last; ++i) {
+			for (int d = 0; d < D; ++d) values[d] = position[d][i];
+			weight[i] = Likelihood(values);
+		}
+	}
+
+	/**
+	 * Systematic resampling. The indices of the particles to keep are selected first, then every
+	 * array is gathered through them. Afterwards all weights are equal.
+	 */
+	void Resample() {
+		int N = weight.size();
+		if (!N) return;
+		double total = 0;
+		for (int i = 0; i < N; ++i) total += weight[i];
+		parents.resize(N);
+		if (total <= 0) {
+			// nothing is likely, keep everybody
+			for (int i = 0; i < N; ++i) parents[i] = i;
+		} else {
+			boost::uniform_01<boost::mt19937&> uniform(random_number_generator);
+			double step = total / N, u = uniform() * step, sum = weight[0];
+			for (int i = 0, j = 0; j < N; ++j, u += step) {
+				while (sum <= u && i < N - 1) sum += weight[++i];
+				parents[j] = i;
+			}
+		}
+		for (int d = 0; d < D; ++d) {
+			Gather(position[d]);
+			Gather(velocity[d]);
+			Gather(variance[d]);
+		}
+		weight.assign(N, 1.0 / N);
+	}
+
+	/**
+	 * The weighted mean of the positions and of the velocities (the means of the Kalman filters).
+	 * @param mean_position		D values
+	 * @param mean_velocity		D values, can be NULL
+	 */
+	void GetEstimate(double *mean_position, double *mean_velocity = NULL) const {
+		int N = weight.size();
+		double total = 0;
+		for (int i = 0; i < N; ++i) total += weight[i];
+		bool uniform = total <= 0;
+		if (uniform) total = N;
+		for (int d = 0; d < D; ++d) {
+			double p = 0, v = 0;
+			for (int i = 0; i < N; ++i) {
+				double w = uniform ? 1.0 : weight[i];
+				p += w * position[d][i];
+				v += w * velocity[d][i];
+			}
+			mean_position[d] = total > 0 ? p / total : 0;
+			if (mean_velocity != NULL) mean_velocity[d] = total > 0 ? v / total : 0;
+		}
+	}
+
+	//! Number of particles
+	inline int GetParticleCount() const { return weight.size(); }
+
+	//! Value d of the position of particle i
+	inline double GetPosition(int i, int d) const { return position[d][i]; }
+
+	//! Mean of the velocity of value d of particle i
+	inline double GetVelocity(int i, int d) const { return velocity[d][i]; }
+
+	//! Variance of the velocity of value d of particle i
+	inline double GetVelocityVariance(int i, int d) const { return variance[d][i]; }
+
+	//! Weight of particle i
+	inline double GetWeight(int i) const { return weight[i]; }
+
+protected:
+	//! How likely the observation is if the object is at the given position (D values)
+	virtual double Likelihood(const double *values) = 0;
+
+private:
+	//! Reorder an array according to the selected parents
+	void Gather(std::vector<double> & values) {
+		int N = parents.size();
+		scratch.resize(N);
+		for (int i = 0; i < N; ++i) scratch[i] = values[parents[i]];
+		values.swap(scratch);
+	}
+
+	//! The sampled positions, per value
+	std::vector<double> position[D];
+
+	//! Mean of the Kalman filter of the velocity, per value
+	std::vector<double> velocity[D];
+
+	//! Variance of the Kalman filter of the velocity, per value
+	std::vector<double> variance[D];
+
+	//! Weight of each particle
+	std::vector<double> weight;
+
+	//! Variance r of the noise on the positions
+	double position_noise[D];
+
+	//! Variance q of the change of the velocities
+	double velocity_noise[D];
+
+	//! Generator for the noise and the resampling
+	boost::mt19937 random_number_generator;
+
+	//! Space for Transition: standard normal samples
+	std::vector<double> noise;
+
+	//! Space for Resample: index of the particle every new particle is a copy of
+	std::vector<int> parents;
+
+	//! Space for Resample
+	std::vector<double> scratch;
+};
+
+#endif /* RAOBLACKWELLIZEDPARTICLEFILTER_HPP_ */
@@ -0,0 +1,80 @@
+/**
+ * @brief Statistics about a stream of images
+ * @file StreamStats.h
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 3, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+
+#ifndef STREAMSTATS_H_
+#define STREAMSTATS_H_
+
+#include <iostream>
+
+#include <LatencyHistogram.h>
+
+/**
+ * A snapshot of the statistics of one stream, from camera to tracker. The rates are averages
+ * since the stream has been started.
+ */
+struct StreamStats {
+	StreamStats(): id(0), frames_acquired(0), frames_tracked(0), queue_depth(0),
+		max_queue_depth(0), frames_dropped(0), frames_decimated(0), acquire_fps(0), track_fps(0) {}
+
+	//! The stream these statistics belong to
+	int id;
+
+	//! Number of images obtained from the image source
+	long frames_acquired;
+
+	//! Number of images that went through the particle filter
+	long frames_tracked;
+
+	//! Number of images waiting to be tracked
+	int queue_depth;
+
+	//! Maximum number of images that have been waiting at the same time
+	int max_queue_depth;
+
+	//! Number of images dropped because the tracker could not keep up
+	long frames_dropped;
+
+	//! Number of images skipped on purpose (see DP_DECIMATE)
+	long frames_decimated;
+
+	//! Images per second obtained from the image source
+	float acquire_fps;
+
+	//! Images per second processed by the particle filter
+	float track_fps;
+
+	//! Time from receiving an image till the particle filter has an estimate for it
+	LatencyHistogram latency;
+
+	//! Easy printing
+	friend std::ostream& operator<<(std::ostream& os, const StreamStats & stats) {
+		os << "stream " << stats.id << ": acquired " << stats.frames_acquired << " (" << stats.acquire_fps
+				<< " fps), tracked " << stats.frames_tracked << " (" << stats.track_fps << " fps), queue "
+				<< stats.queue_depth << " (max " << stats.max_queue_depth << "), dropped " << stats.frames_dropped << ", decimated "
+				<< stats.frames_decimated << ", " << stats.latency;
+		return os;
+	}
+};
+
+#endif /* STREAMSTATS_H_ */
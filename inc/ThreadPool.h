@@ -0,0 +1,141 @@
+/**
+ * @brief A pool of worker threads that run tasks
+ * @file ThreadPool.h
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 3, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+// General files
+#include <pthread.h>
+#include <deque>
+#include <vector>
+
+/* **************************************************************************************
+ * Interface of Task
+ * **************************************************************************************/
+
+/**
+ * Anything that needs to be done by the thread pool. Derive from it and implement Run().
+ */
+class Task {
+public:
+	virtual ~Task() {}
+
+	//! The actual work
+	virtual void Run() = 0;
+};
+
+/**
+ * Tasks can be added as a group, so it is possible to wait for only those tasks to be
+ * finished, while other tasks keep running in the same pool.
+ */
+class TaskGroup {
+public:
+	//! Constructor TaskGroup
+	TaskGroup();
+
+	//! Destructor ~TaskGroup
+	~TaskGroup();
+
+	//! Number of tasks of this group that are not finished yet
+	int Pending();
+
+private:
+	friend class ThreadPool;
+
+	//! Tasks not yet finished
+	int pending;
+
+	//! Protects the counter
+	pthread_mutex_t mutex;
+
+	//! Signalled when the last task finished
+	pthread_cond_t done;
+};
+
+/* **************************************************************************************
+ * Interface of ThreadPool
+ * **************************************************************************************/
+
+/**
+ * A fixed number of worker threads that take tasks from a queue in first-in first-out order.
+ * The pool takes ownership of the tasks and deletes them after they have run.
+ *
+ * Waiting for a group of tasks is done by helping out: the waiting thread runs tasks from the
+ * queue itself. This means it is fine for a task to add tasks to the same pool and wait for
+ * them, even if all worker threads are busy.
+ */
+class ThreadPool {
+public:
+	//! Constructor, with thread_count = 0 there will be as many threads as processors
+	ThreadPool(int thread_count = 0);
+
+	//! Destructor, finishes all tasks in the queue before returning
+	~ThreadPool();
+
+	//! Add a task to the queue (pool becomes owner), optionally as part of a group
+	void Add(Task *task, TaskGroup *group = NULL);
+
+	//! Wait till all tasks of the group are finished
+	void Wait(TaskGroup &group);
+
+	//! Number of worker threads
+	inline int GetThreadCount() { return threads.size(); }
+
+	//! Number of tasks in the queue that have not been started yet
+	int GetQueueSize();
+
+	//! Number of processors that are online
+	static int GetProcessorCount();
+
+protected:
+	//! Entry point for the worker threads
+	static void *Work(void *pool);
+
+	//! Run a task and update its group
+	void Execute(Task *task, TaskGroup *group);
+
+private:
+	//! A task together with the group it belongs to
+	struct Item {
+		Task *task;
+		TaskGroup *group;
+	};
+
+	//! The worker threads
+	std::vector<pthread_t> threads;
+
+	//! Tasks waiting to be executed
+	std::deque<Item> queue;
+
+	//! Protects the queue
+	pthread_mutex_t mutex;
+
+	//! Signalled when there is something in the queue (or on stopping)
+	pthread_cond_t available;
+
+	//! Set on destruction
+	bool stopping;
+};
+
+#endif /* THREADPOOL_H_ */
@@ -0,0 +1,63 @@
+/**
+ * @brief Simple time measurement helpers
+ * @file Timer.hpp
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 2, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+
+#ifndef TIMER_HPP_
+#define TIMER_HPP_
+
+#include <time.h>
+
+namespace dobots {
+
+/**
+ * Time in microseconds from a monotonic clock. Only differences between two of these values
+ * are meaningful, they cannot be compared with wall clock time.
+ */
+inline long long get_time_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+/**
+ * Stopwatch that starts on construction.
+ */
+class Timer {
+public:
+	Timer() { Reset(); }
+
+	//! Start measuring again from now
+	inline void Reset() { start = get_time_us(); }
+
+	//! Microseconds since construction or last reset
+	inline long long Elapsed() const { return get_time_us() - start; }
+
+	//! Time at which this timer has been (re)started
+	inline long long Start() const { return start; }
+private:
+	long long start;
+};
+
+}
+
+#endif /* TIMER_HPP_ */
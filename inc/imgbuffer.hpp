@@ -30,6 +30,8 @@
 
 #include <strstr.h>
 
+#include <cerrno>
+
 using namespace std;
 
 #define CHUNKSIZE 1460
@@ -97,7 +99,7 @@ public:
 
 		header_size = 0;
 		char *p;
-		for (p = last_item_begin; p < last_item_begin+size; ++p) {
+		for (p = last_item_begin; p < last_item_begin+size-1; ++p) {
 			if (((unsigned char)*p == 255) && ((unsigned char)*(p+1) == 216)) { //'0xFF' and '0xD8'
 				header_size = p - last_item_begin;
 				cout << __func__ << ": header size is " << header_size << endl;
@@ -110,6 +112,16 @@ public:
 		return true;
 	}
 
+	/**
+	 * Get the frame number the server put in the header of the item ("X-Frame-Number: "), if there
+	 * is one. The header size is the one of get_item_size.
+	 */
+	bool get_item_frame_number(uint32_t header_size, long & number) {
+		char *ptr = sstrnstr(last_item_begin, "X-Frame-Number: ", header_size);
+		if (!ptr) return false;
+		return sscanf(ptr + 16, "%ld", &number) == 1;
+	}
+
 	/**
 	 * Read bytes from socket and put them in the ringbuffer
 	 */
@@ -125,6 +137,8 @@ public:
 				fprintf(stderr, "read() returned %d bytes\n", nof_bytes_read);
 			return nof_bytes_read;
 		}
+		// on a non-blocking socket there is just nothing to read yet
+		if (nof_bytes_read < 0 && errno == EAGAIN) return nof_bytes_read;
 		fprintf(stderr, "mcamip: read(): returned EOF (power failure, network, interference?)\n");
 
 		return nof_bytes_read;
@@ -143,6 +157,9 @@ public:
 		char *end_ptr = last_item_begin + content_size + header_size;
 //		char *end_ptr = last_item_begin + header_size;
 
+		// the end of the picture has not arrived yet, do not search in stale data
+		if (end_ptr > last_chunk_end) return false;
+
 		int goback = 10;
 
 		cout << __func__ << ": search from " << (end_ptr - goback) - last_item_begin \
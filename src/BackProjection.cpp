@@ -0,0 +1,156 @@
+/**
+ * @brief
+ * @file BackProjection.cpp
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 18, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+#include <BackProjection.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+/* **************************************************************************************
+ * Implementation of BackProjection
+ * **************************************************************************************/
+
+BackProjection::BackProjection(int bins, int channels, ChannelMode channel_mode):
+		ProbMatrix(bins, 0, 0, HM_GLOBAL), configured_channels(channels) {
+	setChannels(channels, channel_mode);
+}
+
+BackProjection::~BackProjection() {
+
+}
+
+/**
+ * Two passes over the image: the first bins the pixels and counts them, the second looks up the
+ * weight of every pixel and sums them. Bins that do not occur in the image get no ratio, no pixel
+ * needs it.
+ */
+void BackProjection::calcBackProjection(const NormalizedHistogramValues & target, pDataMatrix data,
+		int width, int height, int spectrum) {
+	assert (width >= 0 && height >= 0 && spectrum > 0);
+	int used_channels = std::min(configured_channels, spectrum);
+	if (used_channels != channels) setChannels(used_channels, channel_mode);
+	int size = getHistogramSize();
+	assert ((int)target.size() == size);
+	p_width = width;
+	p_height = height;
+	p_size = width * height;
+	frame_count = 1;
+
+	int per_pixel = (channel_mode == CM_JOINT) ? 1 : channels;
+	std::vector<int> counts(size, 0);
+	const int *table = &channel_table[0];
+	if (channel_mode == CM_JOINT) {
+		for (int p = 0; p < p_size; ++p) {
+			int index = 0;
+			for (int c = 0; c < channels; ++c) index += table[c*256+data[c*p_size+p]];
+			counts[index]++;
+		}
+	} else {
+		for (int c = 0; c < channels; ++c) {
+			const DataValue *plane = data + c * p_size;
+			for (int p = 0; p < p_size; ++p) counts[table[c*256+plane[p]]]++;
+		}
+	}
+
+	// the image histogram is normalized the same way as the target (over all of its bins)
+	ratio.assign(size, 0);
+	float max_ratio = 0;
+	int total = p_size * per_pixel;
+	for (int b = 0; b < size; ++b) {
+		if (!counts[b]) continue;
+		ratio[b] = target[b] / ((float)counts[b] / total);
+		max_ratio = std::max(max_ratio, ratio[b]);
+	}
+	if (max_ratio > 0)
+		for (int b = 0; b < size; ++b) ratio[b] /= max_ratio;
+
+	weights.resize(p_size);
+	if (channel_mode == CM_JOINT) {
+		for (int p = 0; p < p_size; ++p) {
+			int index = 0;
+			for (int c = 0; c < channels; ++c) index += table[c*256+data[c*p_size+p]];
+			weights[p] = ratio[index];
+		}
+	} else {
+		lut.resize(channels * 256);
+		for (int i = 0; i < channels * 256; ++i) lut[i] = ratio[table[i]] / channels;
+		std::fill(weights.begin(), weights.end(), 0.0f);
+		for (int c = 0; c < channels; ++c) {
+			const DataValue *plane = data + c * p_size;
+			const float *channel_lut = &lut[c * 256];
+			for (int p = 0; p < p_size; ++p) weights[p] += channel_lut[plane[p]];
+		}
+	}
+
+	int row_size = width + 1;
+	sum.assign((size_t)(height + 1) * row_size, 0);
+	sum_x.assign(sum.size(), 0);
+	sum_y.assign(sum.size(), 0);
+	for (int y = 0; y < height; ++y) {
+		double row = 0, row_x = 0;
+		const float *w = &weights[y * width];
+		for (int x = 0; x < width; ++x) {
+			row += w[x];
+			row_x += w[x] * x;
+			int i = (y + 1) * row_size + x + 1;
+			sum[i] = sum[i - row_size] + row;
+			sum_x[i] = sum_x[i - row_size] + row_x;
+			sum_y[i] = sum_y[i - row_size] + row * y;
+		}
+	}
+}
+
+double BackProjection::getSum(const std::vector<double> & table, int x0, int y0, int x1, int y1) const {
+	x0 = std::max(x0, 0);
+	y0 = std::max(y0, 0);
+	x1 = std::min(x1, p_width - 1);
+	y1 = std::min(y1, p_height - 1);
+	if (x0 > x1 || y0 > y1) return 0;
+	int row_size = p_width + 1;
+	return table[(y1 + 1) * row_size + x1 + 1] - table[(y1 + 1) * row_size + x0]
+			- table[y0 * row_size + x1 + 1] + table[y0 * row_size + x0];
+}
+
+/**
+ * With a flat kernel (the shadow of the Epanechnikov kernel) the mean-shift step goes to the
+ * weighted centroid of the rectangle, which follows from the summed-area tables.
+ */
+int BackProjection::meanShift(float & x, float & y, float width, float height, int iterations, float epsilon) const {
+	int i = 0;
+	for (; i < iterations; ++i) {
+		int x0 = (int)(x - width/2), y0 = (int)(y - height/2);
+		int x1 = (int)(x + width/2), y1 = (int)(y + height/2);
+		double total = getSum(sum, x0, y0, x1, y1);
+		if (total <= 0) break;
+		float nx = getSum(sum_x, x0, y0, x1, y1) / total, ny = getSum(sum_y, x0, y0, x1, y1) / total;
+		float shift = std::abs(nx - x) + std::abs(ny - y);
+		x = nx;
+		y = ny;
+		if (shift < epsilon) {
+			++i;
+			break;
+		}
+	}
+	return i;
+}
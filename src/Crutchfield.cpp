@@ -22,9 +22,11 @@
  */
 
 #include <Crutchfield.h>
+#include <ThreadPool.h>
 
 #include <iostream>
 #include <assert.h>
+#include <math.h>
 
 using namespace std;
 
@@ -34,7 +36,7 @@ using namespace std;
 
 Crutchfield::Crutchfield(int bins, int width, int height): Histogram(bins, width, height),
 		DistanceSource(),
-		dist(NULL) {
+		dist(NULL), window_size(0), window_next(0) {
 
 }
 
@@ -49,24 +51,160 @@ void Crutchfield::Clear() {
 	dist = NULL;
 }
 
+/**
+ * A tile of the distance matrix.
+ */
+class CrutchfieldTask: public Task {
+public:
+	CrutchfieldTask(Crutchfield *crutchfield, int p0_begin, int p0_end, int p1_begin, int p1_end):
+		crutchfield(crutchfield), p0_begin(p0_begin), p0_end(p0_end), p1_begin(p1_begin),
+		p1_end(p1_end) {}
+	void Run() { crutchfield->calcDistances(p0_begin, p0_end, p1_begin, p1_end); }
+private:
+	Crutchfield *crutchfield;
+	int p0_begin, p0_end, p1_begin, p1_end;
+};
+
 /**
  * Calculates all mutual distances between "sensors". This will fill the "dist" matrix. We
  * will loop over all possible sensor pairs and calculate their distance (considering a
- * series of images) using the calcDistance function.
+ * series of images).
+ *
+ * The distance is symmetric, so only the pairs with p1 < p0 are calculated and the result is
+ * written to both halves of the matrix. These pairs are cut in square tiles (the ones on the
+ * diagonal are triangles) that run on a thread pool.
  *
  * The only thing you might to take a look at is the default binning procedure.
  */
-void Crutchfield::calcDistances() {
-	CHECK_DIST;
+void Crutchfield::calcDistances(int thread_count, int tile_size) {
 	Clear();
+	window_size = 0;
+	assert (tile_size > 0);
 
 	cout << "Calculate distances" << endl;
 	dist = new Value[p_size * p_size];
-	for (int p0 = 0; p0 < p_size; p0++) {
-		for (int p1 = 0; p1 < p_size; p1++) {
-			dist[p0*p_size+p1] = calcDistance(p0, p1);
+	for (int p = 0; p < p_size; ++p) dist[p*p_size+p] = 0;
+	calcEntropyTables();
+
+	ThreadPool pool(thread_count);
+	TaskGroup group;
+	for (int p0 = 0; p0 < p_size; p0 += tile_size) {
+		for (int p1 = 0; p1 <= p0; p1 += tile_size) {
+			pool.Add(new CrutchfieldTask(this, p0, std::min(p0 + tile_size, p_size), p1,
+					std::min(p1 + tile_size, p_size)), &group);
+		}
+	}
+	pool.Wait(group);
+}
+
+void Crutchfield::calcDistances(int p0_begin, int p0_end, int p1_begin, int p1_end) {
+	CHECK_DIST;
+	assert (frame_count > 0);
+	std::vector<int> counts(bins_squared, 0);
+	std::vector<int> touched;
+	touched.reserve(frame_count);
+	for (int p0 = p0_begin; p0 < p0_end; ++p0) {
+		for (int p1 = p1_begin; p1 < p1_end && p1 < p0; ++p1) {
+			Value d = calcPairDistance(p0, p1, counts, touched);
+			dist[p0*p_size+p1] = d;
+			dist[p1*p_size+p0] = d;
+		}
+	}
+}
+
+/**
+ * A tile of a mapped distance matrix.
+ */
+class CrutchfieldMappedTask: public Task {
+public:
+	CrutchfieldMappedTask(Crutchfield *crutchfield, MappedDistanceMatrix *matrix, int tile0,
+			int tile1): crutchfield(crutchfield), matrix(matrix), tile0(tile0), tile1(tile1) {}
+	void Run() { crutchfield->calcDistances(*matrix, tile0, tile1); }
+private:
+	Crutchfield *crutchfield;
+	MappedDistanceMatrix *matrix;
+	int tile0, tile1;
+};
+
+void Crutchfield::calcDistances(MappedDistanceMatrix & matrix, int thread_count) {
+	ASSERT_EQUAL(matrix.getSensorCount(), p_size);
+	calcEntropyTables();
+
+	ThreadPool pool(thread_count);
+	TaskGroup group;
+	for (int tile0 = 0; tile0 < matrix.getTileCount(); ++tile0) {
+		for (int tile1 = 0; tile1 <= tile0; ++tile1) {
+			if (matrix.isTileDone(tile0, tile1)) continue;
+			pool.Add(new CrutchfieldMappedTask(this, &matrix, tile0, tile1), &group);
 		}
 	}
+	pool.Wait(group);
+	matrix.Sync();
+}
+
+void Crutchfield::calcDistances(MappedDistanceMatrix & matrix, int tile0, int tile1) {
+	assert (frame_count > 0);
+	std::vector<int> counts(bins_squared, 0);
+	std::vector<int> touched;
+	touched.reserve(frame_count);
+	int tile_size = matrix.getTileSize();
+	float *tile = matrix.getTile(tile0, tile1);
+	for (int i = 0; i < tile_size; ++i) {
+		int p0 = tile0 * tile_size + i;
+		for (int j = 0; j < tile_size; ++j) {
+			int p1 = tile1 * tile_size + j;
+			bool valid = (p0 < p_size) && (p1 < p0);
+			tile[i * tile_size + j] = valid ? calcPairDistance(p0, p1, counts, touched) : 0;
+		}
+	}
+	matrix.setTileDone(tile0, tile1);
+}
+
+Value Crutchfield::calcPairDistance(int p0, int p1, std::vector<int> & counts, std::vector<int> & touched) {
+	double s = marginal_sum[p0] + marginal_sum[p1] - 2 * calcJointSum(p0, p1, counts, touched);
+	return std::max(0.0, s / (frame_count * log(2.0)));
+}
+
+/**
+ * With n(x) the frequency of bin x of one pixel, n(y) of the other, and n(x,y) the joint
+ * frequency, over T frames:
+ *
+ *   T H(Y|X) = - SUM_x,y n(x,y) log { n(x,y) / n(x) } = SUM_x n(x) log n(x) - SUM_x,y n(x,y) log n(x,y)
+ *
+ * because summing n(x,y) over y gives n(x). So the distance only needs the sums of n log n over
+ * the bins of each pixel, which are calculated once, and over the joint bins of each pair. The
+ * values of n are integers in [0,T], so n log n comes from a table.
+ */
+void Crutchfield::calcEntropyTables() {
+	CHECK_FREQ;
+	nlogn.resize(frame_count + 1);
+	nlogn[0] = 0;
+	for (int n = 1; n <= frame_count; ++n) nlogn[n] = n * log((double)n);
+	marginal_sum.assign(p_size, 0);
+	for (int p = 0; p < p_size; ++p) {
+		for (int b = 0; b < bins; ++b) marginal_sum[p] += nlogn[getFrequency(p, b)];
+	}
+}
+
+/**
+ * Counting goes over the time series of both pixels, so it takes T steps. Only the joint bins
+ * that have been used are summed and reset, so it does not matter how many bins there are.
+ */
+double Crutchfield::calcJointSum(int p0, int p1, std::vector<int> & counts, std::vector<int> & touched) {
+	CHECK_JOINTFREQ;
+	const unsigned char *s0 = joint_freq->getSeries(p0);
+	const unsigned char *s1 = joint_freq->getSeries(p1);
+	touched.clear();
+	for (int t = 0; t < frame_count; ++t) {
+		int index = s0[t] + bins * s1[t];
+		if (!counts[index]++) touched.push_back(index);
+	}
+	double sum = 0;
+	for (size_t i = 0; i < touched.size(); ++i) {
+		sum += nlogn[counts[touched[i]]];
+		counts[touched[i]] = 0;
+	}
+	return sum;
 }
 
 
@@ -86,3 +224,85 @@ Value Crutchfield::calcDistance(int p0, int p1) {
 	assert (dist >= 0);
 	return dist;
 }
+
+/**
+ * With the sums of n log n (see calcEntropyTables) T H(Y|X) = SUM_x n(x) log n(x) - SUM_x,y n(x,y)
+ * log n(x,y), where the last sum is kept per pair in sliding window mode.
+ */
+Value Crutchfield::getConditionalEntropy(int p0, int p1) {
+	if (!window_size) return Histogram::getConditionalEntropy(p0, p1);
+	if (p0 == p1 || !frame_count) return 0;
+	size_t pair = (p0 > p1) ? (size_t)p0 * (p0 - 1) / 2 + p1 : (size_t)p1 * (p1 - 1) / 2 + p0;
+	return (marginal_sum[p0] - joint_sum[pair]) / (frame_count * log(2.0));
+}
+
+/**
+ * The frequencies start at zero, so the distances are calculated over the frames that are in the
+ * window so far till the window is full.
+ */
+void Crutchfield::setWindow(int window_size) {
+	assert (window_size > 0 && window_size < 65536);
+	Clear();
+	Histogram::Clear();
+	this->window_size = window_size;
+	frame_count = 0;
+	window_next = 0;
+	window.assign((size_t)window_size * p_size, 0);
+	freq = new HistogramValue[bins * p_size];
+	std::fill_n(freq, bins * p_size, (HistogramValue)0);
+	size_t pairs = (size_t)p_size * (p_size - 1) / 2;
+	pair_counts.assign(pairs * bins_squared, 0);
+	joint_sum.assign(pairs, 0);
+	marginal_sum.assign(p_size, 0);
+	nlogn.resize(window_size + 1);
+	nlogn[0] = 0;
+	for (int n = 1; n <= window_size; ++n) nlogn[n] = n * log((double)n);
+	dist = new Value[p_size * p_size];
+	std::fill_n(dist, p_size * p_size, (Value)0);
+}
+
+/**
+ * Removing a frame decrements one (joint) counter per pixel (pair), adding one increments one.
+ * The sums of n log n only change in the terms of these counters, so they are updated with the
+ * differences. See calcEntropyTables for how the distance follows from these sums.
+ */
+void Crutchfield::addFrame(pDataMatrix frame) {
+	assert (window_size > 0);
+	CHECK_FREQ;
+	CHECK_DIST;
+	unsigned char *slot = &window[(size_t)window_next * p_size];
+	bool remove = (frame_count == window_size);
+	window_next = (window_next + 1) % window_size;
+	if (!remove) frame_count++;
+
+	// the old bins are in the slot till they are overwritten here
+	std::vector<unsigned char> old_bins(slot, slot + p_size);
+	for (int p = 0; p < p_size; ++p) {
+		HistogramValue *f = &freq[p*bins];
+		if (remove) {
+			HistogramValue n = f[old_bins[p]]--;
+			marginal_sum[p] += nlogn[n-1] - nlogn[n];
+		}
+		slot[p] = lookupBin(frame[p]);
+		HistogramValue n = f[slot[p]]++;
+		marginal_sum[p] += nlogn[n+1] - nlogn[n];
+	}
+
+	double normalization = 1.0 / (frame_count * log(2.0));
+	size_t pair = 0;
+	for (int p0 = 1; p0 < p_size; ++p0) {
+		for (int p1 = 0; p1 < p0; ++p1, ++pair) {
+			unsigned short *c = &pair_counts[pair * bins_squared];
+			double &s = joint_sum[pair];
+			if (remove) {
+				int n = c[old_bins[p0] + bins * old_bins[p1]]--;
+				s += nlogn[n-1] - nlogn[n];
+			}
+			int n = c[slot[p0] + bins * slot[p1]]++;
+			s += nlogn[n+1] - nlogn[n];
+			Value d = std::max(0.0, (marginal_sum[p0] + marginal_sum[p1] - 2 * s) * normalization);
+			dist[p0*p_size+p1] = d;
+			dist[p1*p_size+p0] = d;
+		}
+	}
+}
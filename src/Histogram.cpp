@@ -37,7 +37,8 @@ using namespace std;
 /**
  * For histogram calculations we only need to count
  */
-Histogram::Histogram(int bins, int width, int height): ProbMatrix(bins, width, height) {
+Histogram::Histogram(int bins, int width, int height, HistogramMode mode):
+		ProbMatrix(bins, width, height, mode) {
 
 }
 
@@ -68,9 +69,13 @@ void Histogram::Clear() {
 #ifdef VERBOSE
 		cout << __func__ << ": clear joint frequency table" << endl;
 #endif
-		delete [] joint_freq;
+		delete joint_freq;
 	}
-	freq = joint_freq = NULL;
+	if (global_freq != NULL) {
+		delete [] global_freq;
+	}
+	freq = global_freq = NULL;
+	joint_freq = NULL;
 }
 
 /**
@@ -92,6 +97,11 @@ void Histogram::calcProbabilities(DataFrames & frames) {
 	// Delete previous matrices
 	Clear();
 
+	if (mode == HM_GLOBAL) {
+		calcGlobalFrequencies(frames);
+		return;
+	}
+
 	// Create probability matrix
 #ifdef VERBOSE
 	// Show size to the user
@@ -112,7 +122,7 @@ void Histogram::calcProbabilities(DataFrames & frames) {
 	for (int p = 0; p < p_size; ++p) {
 		for (int t = 0; t < frame_count; ++t) {
 			pDataMatrix data = frames[t];
-			int bin = value2bin(data[p]);
+			int bin = lookupBin(data[p]);
 #ifdef CAREFUL_USAGE
 			assert (p*bins+bin < bins * p_size);
 #endif
@@ -124,36 +134,84 @@ void Histogram::calcProbabilities(DataFrames & frames) {
 #endif
 
 #ifdef CALC_JOINTFREQ
-	// Create joint probability matrix
-	cout << "Create joint probability matrix of size " << bins << "x" << bins << " * " << p_size * p_size << endl;
-	joint_freq = new HistogramValue[bins_squared * p_size * p_size];
-	std::fill_n(joint_freq, bins_squared * p_size * p_size, (HistogramValue)0);
-	if (joint_freq == NULL) {
-		cerr << "Joint probability matrix could not be allocated" << endl;
-		QUIT_ON_ERROR;
+	// Store the bins of all pixels over time, the joint frequencies are derived from it when needed
+	joint_freq = new JointFrequencies(bins, p_size);
+	std::vector<unsigned char> binned((size_t)p_size * frame_count);
+	std::vector<unsigned char*> binned_frames(frame_count);
+	for (int t = 0; t < frame_count; ++t) {
+		pDataMatrix data = frames[t];
+		unsigned char *frame_bins = &binned[(size_t)t*p_size];
+		for (int p = 0; p < p_size; ++p) {
+			frame_bins[p] = lookupBin(data[p]);
+		}
+		binned_frames[t] = frame_bins;
 	}
+	joint_freq->setBins(binned_frames);
+#endif
+}
 
-	// Fill joint probability matrix
-	cout << "Fill joint probability matrix" << endl;
+/**
+ * Counts the values of all pixels in a single histogram. With multiple channels, all channels of
+ * a pixel are handled in the same pass: the values at p, p+p_size, p+2*p_size, etc.
+ *
+ * Incrementing the same counter for successive pixels (which is the normal case, neighbouring
+ * pixels have similar values) makes every increment wait for the previous one to be written.
+ * Hence, four pixels in a row are counted in four separate tables that are summed at the end.
+ * For a single channel these tables are indexed by the raw 8-bit value, so the bin lookup is only
+ * done 256 times at the end, not for every pixel.
+ */
+void Histogram::calcGlobalFrequencies(DataFrames & frames) {
+	int size = getHistogramSize();
+	global_freq = new HistogramValue[size];
+	std::fill_n(global_freq, size, (HistogramValue)0);
+	const int *table = &channel_table[0];
+	const int tables = 4;
+	int table_size = (channels == 1) ? 256 : size;
+	std::vector<HistogramValue> counts(tables * table_size, 0);
+	HistogramValue *c0 = &counts[0], *c1 = c0 + table_size, *c2 = c1 + table_size, *c3 = c2 + table_size;
+	int p_end = p_size - p_size % tables;
 	for (int t = 0; t < frame_count; ++t) {
-		for (int p0 = 0; p0 < p_size; ++p0) {
-			for (int p1 = 1; p1 < p_size; ++p1) {
-				if (p0 <= p1) continue; // omit filling in bottom triangle of matrix
-				pDataMatrix data = frames[t];
-				int bin0 = value2bin(data[p0]);
-				int bin1 = value2bin(data[p1]);
-				int m = p0*bins_squared + p1*bins_squared*p_size; //offset
-				joint_freq[m+bin0+bins*bin1]++;
-#ifdef VERBOSE
-				cout << "Calculate bin " << bin1 << "=" << s1.val[0] << "*" << bins << "/256" << endl;
-				cout << "Joint freq " << p0 << "," << p1 << ":" << bin0 << "," << bin1 << " ++" << endl;
-				cout << "Thus m becomes " << p0*bins*bins << "+" << p1*bins*bins*p_width*p_height << "=" << m << endl;
-				cout << "Increment position m+" << bin0*bins << "+" << bin1 << "=" << m+bin0*bins+bin1 << endl;
-#endif
+		pDataMatrix data = frames[t];
+		if (channels == 1) {
+			int p = 0;
+			for (; p < p_end; p += tables) {
+				c0[data[p]]++;
+				c1[data[p+1]]++;
+				c2[data[p+2]]++;
+				c3[data[p+3]]++;
+			}
+			for (; p < p_size; ++p) c0[data[p]]++;
+		} else if (channel_mode == CM_JOINT && channels == 3) {
+			pDataMatrix data1 = data + p_size, data2 = data + 2*p_size;
+			const int *table1 = table + 256, *table2 = table + 512;
+			int p = 0;
+			for (; p < p_end; p += tables) {
+				c0[table[data[p]]   + table1[data1[p]]   + table2[data2[p]]]++;
+				c1[table[data[p+1]] + table1[data1[p+1]] + table2[data2[p+1]]]++;
+				c2[table[data[p+2]] + table1[data1[p+2]] + table2[data2[p+2]]]++;
+				c3[table[data[p+3]] + table1[data1[p+3]] + table2[data2[p+3]]]++;
+			}
+			for (; p < p_size; ++p) c0[table[data[p]] + table1[data1[p]] + table2[data2[p]]]++;
+		} else if (channel_mode == CM_JOINT) {
+			for (int p = 0; p < p_size; ++p) {
+				int index = 0;
+				for (int c = 0; c < channels; ++c) index += table[c*256+data[c*p_size+p]];
+				counts[(p % tables) * table_size + index]++;
+			}
+		} else {
+			// each channel goes to its own part of the histogram, so there is less contention
+			for (int p = 0; p < p_size; ++p) {
+				for (int c = 0; c < channels; ++c) c0[table[c*256+data[c*p_size+p]]]++;
 			}
 		}
 	}
-#endif
+
+	// merge the tables
+	for (int i = 0; i < table_size; ++i) {
+		HistogramValue f = c0[i] + c1[i] + c2[i] + c3[i];
+		if (channels == 1) global_freq[bin_table[i]] += f;
+		else global_freq[i] += f;
+	}
 }
 
 /**
@@ -198,9 +256,14 @@ Value Histogram::getConditionalEntropy(int p0, int p1) {
 
 void Histogram::getFrequencies(vector<HistogramValue> &bin_result) {
 	CHECK_FRAMECOUNT;
-	CHECK_FREQ;
 	bin_result.clear();
 
+	if (mode == HM_GLOBAL) {
+		bin_result.assign(global_freq, global_freq + getHistogramSize());
+		return;
+	}
+
+	CHECK_FREQ;
 	for (int b = 0; b < bins; ++b) {
 		int f = 0;
 		for (int p = 0; p < p_size; ++p) {
@@ -212,8 +275,13 @@ void Histogram::getFrequencies(vector<HistogramValue> &bin_result) {
 
 int Histogram::getSamples() {
 	CHECK_FRAMECOUNT;
-	CHECK_FREQ;
 	int f = 0;
+	if (mode == HM_GLOBAL) {
+		int size = getHistogramSize();
+		for (int b = 0; b < size; ++b) f += global_freq[b];
+		return f;
+	}
+	CHECK_FREQ;
 	for (int b = 0; b < bins; ++b) {
 		for (int p = 0; p < p_size; ++p) {
 			f += freq[p*bins+b];
@@ -224,20 +292,28 @@ int Histogram::getSamples() {
 
 void Histogram::getProbabilities(vector<Value> &bin_result) {
 	CHECK_FRAMECOUNT;
-	CHECK_FREQ;
 	bin_result.clear();
 
 	int sum_f = 0;
-	for (int b = 0; b < bins; ++b) {
-		int f = 0;
-		for (int p = 0; p < p_size; ++p) {
-			f += freq[p*bins+b];
+	if (mode == HM_GLOBAL) {
+		int size = getHistogramSize();
+		for (int b = 0; b < size; ++b) {
+			sum_f += global_freq[b];
+			bin_result.push_back(global_freq[b]);
+		}
+	} else {
+		CHECK_FREQ;
+		for (int b = 0; b < bins; ++b) {
+			int f = 0;
+			for (int p = 0; p < p_size; ++p) {
+				f += freq[p*bins+b];
+			}
+			sum_f += f;
+			bin_result.push_back(f);
 		}
-		sum_f += f;
-		bin_result.push_back(f);
 	}
 	assert (sum_f != 0);
-	for (int b = 0; b < bins; ++b) {
+	for (size_t b = 0; b < bin_result.size(); ++b) {
 		bin_result[b] /= (Value)sum_f;
 	}
 }
@@ -258,8 +334,7 @@ void Histogram::printJointFrequencies(int bin0, int bin1) {
 				for (int j1 = 0; j1 < p_height; j1++) {
 					int p0 = j0 * p_width + i0;
 					int p1 = j1 * p_width + i1;
-					int m = p0*bins*bins+p1*bins*bins*p_width*p_height; //offset
-					cout << joint_freq[m+bin0+bins*bin1] << ", ";
+					cout << getJointFrequency(p0, bin0, p1, bin1) << ", ";
 				}
 			}
 			cout << endl;
@@ -270,8 +345,7 @@ void Histogram::printJointFrequencies(int bin0, int bin1) {
 void Histogram::printJointFrequenciesForPixels(int p0, int p1) {
 	for (int bin0 = 0; bin0 < bins; bin0++) {
 		for (int bin1 = 0; bin1 < bins; bin1++) {
-			int m = p0*bins*bins+p1*bins*bins*p_width*p_height;
-			cout << joint_freq[m+bin0+bins*bin1] << ", ";
+			cout << getJointFrequency(p0, bin0, p1, bin1) << ", ";
 		}
 		cout << endl;
 	}
@@ -285,7 +359,8 @@ void Histogram::printJointFrequencies(char printmode) {
 		cout << "Width = " << w << " and height = " << h << endl;
 		for (int i = 0; i < h; i++) {
 			for (int j = 0; j < w; j++) {
-				cout << joint_freq[i*w+j] << ", ";
+				int p0 = i / p_size, p1 = i % p_size;
+				cout << getJointFrequency(p0, j % bins, p1, j / bins) << ", ";
 			}
 			cout << endl;
 		}
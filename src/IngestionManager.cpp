@@ -0,0 +1,204 @@
+/**
+ * @brief
+ * @file IngestionManager.cpp
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 3, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+#include <IngestionManager.h>
+#include <Timer.hpp>
+
+#include <unistd.h>
+
+using namespace std;
+
+/* **************************************************************************************
+ * Implementation of IngestionManager
+ * **************************************************************************************/
+
+IngestionManager::IngestionManager(ThreadPool & pool, int max_queue_depth, DropPolicy policy,
+		int decimation): pool(pool), max_queue_depth(max_queue_depth), policy(policy),
+		decimation(decimation), start_time(0), running(false) {
+	assert (max_queue_depth > 0 && decimation > 0);
+	streams.clear();
+}
+
+IngestionManager::~IngestionManager() {
+	Stop();
+	for (size_t i = 0; i < streams.size(); ++i) {
+		Stream *stream = streams[i];
+		pthread_cond_destroy(&stream->not_full);
+		pthread_mutex_destroy(&stream->mutex);
+		delete stream->queue;
+		delete stream->source;
+		delete stream->filter;
+		delete stream;
+	}
+	streams.clear();
+}
+
+int IngestionManager::AddStream(ImageSource<Image> *source, PositionParticleFilter *filter, int subticks) {
+	assert (!running);
+	assert (source != NULL && filter != NULL);
+	Stream *stream = new Stream();
+	stream->id = streams.size();
+	stream->source = source;
+	stream->filter = filter;
+	stream->subticks = subticks;
+	stream->queue = new FrameQueue<Image>(max_queue_depth, policy, decimation);
+	stream->tracking = false;
+	stream->started = false;
+	stream->stats.id = stream->id;
+	stream->manager = this;
+	source->SetSourceId(stream->id);
+	pthread_mutex_init(&stream->mutex, NULL);
+	pthread_cond_init(&stream->not_full, NULL);
+	streams.push_back(stream);
+	return stream->id;
+}
+
+bool IngestionManager::Start() {
+	if (running) return false;
+	running = true;
+	start_time = dobots::get_time_us();
+	bool success = true;
+	for (size_t i = 0; i < streams.size(); ++i) {
+		Stream *stream = streams[i];
+		stream->started = success &&
+				(pthread_create(&stream->thread, NULL, IngestionManager::Acquire, stream) == 0);
+		if (success && !stream->started) {
+			cerr << __func__ << ": could not start acquisition of stream " << i << endl;
+			success = false;
+		}
+	}
+	if (!success) Stop();
+	return success;
+}
+
+/**
+ * An acquisition thread that is blocked within getImage of its source, will only stop after
+ * it got its image.
+ */
+void IngestionManager::Stop() {
+	if (!running) return;
+	running = false;
+	for (size_t i = 0; i < streams.size(); ++i) {
+		Stream *stream = streams[i];
+		pthread_mutex_lock(&stream->mutex);
+		pthread_cond_broadcast(&stream->not_full);
+		pthread_mutex_unlock(&stream->mutex);
+		if (stream->started)
+			pthread_join(stream->thread, NULL);
+		stream->started = false;
+	}
+	pool.Wait(group);
+}
+
+void IngestionManager::GetStats(int id, StreamStats & stats) {
+	assert (id >= 0 && id < (int)streams.size());
+	Stream *stream = streams[id];
+	pthread_mutex_lock(&stream->mutex);
+	stats = stream->stats;
+	stats.queue_depth = stream->queue->Size();
+	stats.frames_dropped = stream->queue->Dropped();
+	stats.frames_decimated = stream->queue->Decimated();
+	pthread_mutex_unlock(&stream->mutex);
+	float seconds = (dobots::get_time_us() - start_time) / 1000000.0;
+	if (seconds > 0) {
+		stats.acquire_fps = stats.frames_acquired / seconds;
+		stats.track_fps = stats.frames_tracked / seconds;
+	}
+}
+
+void IngestionManager::PrintStats(std::ostream & os) {
+	for (size_t i = 0; i < streams.size(); ++i) {
+		StreamStats stats;
+		GetStats(i, stats);
+		os << stats << endl;
+	}
+}
+
+void *IngestionManager::Acquire(void *s) {
+	Stream *stream = (Stream*)s;
+	stream->manager->Acquire(*stream);
+	return NULL;
+}
+
+/**
+ * Acquire images and queue them. If there is no tick scheduled for this stream, schedule one.
+ * Only with DP_BLOCK this thread waits for the tracker, with the other policies the queue drops
+ * frames, so the tracker always gets the most recent ones.
+ */
+void IngestionManager::Acquire(Stream & stream) {
+	while (running) {
+		Frame<Image> frame = stream.source->getFrame();
+		if (frame.image == NULL) {
+			usleep(1000);
+			continue;
+		}
+
+		pthread_mutex_lock(&stream.mutex);
+		bool queued = false;
+		while (running && !(queued = stream.queue->Push(frame))) {
+			pthread_cond_wait(&stream.not_full, &stream.mutex);
+		}
+		if (!queued) {
+			pthread_mutex_unlock(&stream.mutex);
+			delete frame.image;
+			break;
+		}
+		stream.stats.frames_acquired++;
+		stream.stats.max_queue_depth = std::max(stream.stats.max_queue_depth, stream.queue->Size());
+		if (stream.queue->Empty()) {
+			// decimated
+			pthread_mutex_unlock(&stream.mutex);
+			continue;
+		}
+		bool schedule = !stream.tracking;
+		stream.tracking = true;
+		pthread_mutex_unlock(&stream.mutex);
+
+		if (schedule) pool.Add(new TrackTask(this, &stream), &group);
+	}
+}
+
+/**
+ * Only one image is tracked per task. If there are more images waiting, a new task is added
+ * to the back of the queue of the pool, so that the other streams get their turn too.
+ */
+void IngestionManager::Track(Stream & stream) {
+	pthread_mutex_lock(&stream.mutex);
+	Frame<Image> frame;
+	bool available = stream.queue->Pop(frame);
+	assert (available);
+	pthread_cond_signal(&stream.not_full);
+	pthread_mutex_unlock(&stream.mutex);
+
+	stream.filter->Tick(frame, stream.subticks);
+	delete frame.image;
+
+	pthread_mutex_lock(&stream.mutex);
+	stream.stats.frames_tracked++;
+	stream.stats.latency.Add(stream.filter->GetLastLatency());
+	bool schedule = !stream.queue->Empty();
+	stream.tracking = schedule;
+	pthread_mutex_unlock(&stream.mutex);
+
+	if (schedule) pool.Add(new TrackTask(this, &stream), &group);
+}
@@ -0,0 +1,106 @@
+/**
+ * @brief
+ * @file IntegralHistogram.cpp
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 12, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+#include <IntegralHistogram.h>
+
+#include <algorithm>
+#include <cassert>
+
+/* **************************************************************************************
+ * Implementation of IntegralHistogram
+ * **************************************************************************************/
+
+IntegralHistogram::IntegralHistogram(int bins, int channels, ChannelMode channel_mode):
+		ProbMatrix(bins, 0, 0, HM_GLOBAL), configured_channels(channels), size(0) {
+	setChannels(channels, channel_mode);
+	size = getHistogramSize();
+}
+
+IntegralHistogram::~IntegralHistogram() {
+
+}
+
+/**
+ * Row by row: the histogram of the row up to x is kept up to date, and added to the integral of
+ * the row above.
+ */
+void IntegralHistogram::calcIntegral(pDataMatrix data, int width, int height, int spectrum) {
+	assert (width >= 0 && height >= 0 && spectrum > 0);
+	int used_channels = std::min(configured_channels, spectrum);
+	if (used_channels != channels) {
+		setChannels(used_channels, channel_mode);
+		size = getHistogramSize();
+	}
+	p_width = width;
+	p_height = height;
+	p_size = width * height;
+	frame_count = 1;
+
+	int row_size = (width + 1) * size;
+	integral.assign((size_t)(height + 1) * row_size, 0);
+	std::vector<unsigned int> row(size);
+	const int *table = &channel_table[0];
+	for (int y = 0; y < height; ++y) {
+		std::fill(row.begin(), row.end(), 0);
+		const unsigned int *above = &integral[y * row_size + size];
+		unsigned int *current = &integral[(y + 1) * row_size + size];
+		for (int x = 0; x < width; ++x) {
+			int p = y * width + x;
+			if (channel_mode == CM_JOINT) {
+				int index = 0;
+				for (int c = 0; c < channels; ++c) index += table[c*256+data[c*p_size+p]];
+				row[index]++;
+			} else {
+				for (int c = 0; c < channels; ++c) row[table[c*256+data[c*p_size+p]]]++;
+			}
+			for (int b = 0; b < size; ++b)
+				current[b] = above[b] + row[b];
+			above += size;
+			current += size;
+		}
+	}
+}
+
+void IntegralHistogram::getProbabilities(int x0, int y0, int x1, int y1, NormalizedHistogramValues & result) const {
+	result.assign(size, 0);
+	x0 = std::max(x0, 0);
+	y0 = std::max(y0, 0);
+	x1 = std::min(x1, p_width - 1);
+	y1 = std::min(y1, p_height - 1);
+	if (x0 > x1 || y0 > y1) return;
+
+	int row_size = (p_width + 1) * size;
+	const unsigned int *top_left = &integral[y0 * row_size + x0 * size];
+	const unsigned int *top_right = &integral[y0 * row_size + (x1 + 1) * size];
+	const unsigned int *bottom_left = &integral[(y1 + 1) * row_size + x0 * size];
+	const unsigned int *bottom_right = &integral[(y1 + 1) * row_size + (x1 + 1) * size];
+	int sum = 0;
+	for (int b = 0; b < size; ++b) {
+		unsigned int count = bottom_right[b] - bottom_left[b] - top_right[b] + top_left[b];
+		result[b] = count;
+		sum += count;
+	}
+	if (!sum) return;
+	for (int b = 0; b < size; ++b)
+		result[b] /= (Value)sum;
+}
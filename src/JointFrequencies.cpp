@@ -0,0 +1,178 @@
+/**
+ * @brief
+ * @file JointFrequencies.cpp
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 9, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+#include <JointFrequencies.h>
+
+#include <algorithm>
+#include <cassert>
+
+/* **************************************************************************************
+ * Implementation of JointFrequencies
+ * **************************************************************************************/
+
+JointFrequencies::JointFrequencies(int bins, int p_size, int block_size): bins(bins),
+		bins_squared(bins*bins), p_size(p_size), block_size(block_size), frame_count(0),
+		sparse(false), memory_limit(256 << 20), memory_used(0) {
+	assert (bins > 0 && bins <= 256);
+	assert (block_size > 0);
+	block_count = (p_size + block_size - 1) / block_size;
+}
+
+JointFrequencies::~JointFrequencies() {
+	Clear();
+}
+
+void JointFrequencies::Clear() {
+	for (std::map<int, Block*>::iterator i = blocks.begin(); i != blocks.end(); ++i) {
+		delete i->second;
+	}
+	blocks.clear();
+	order.clear();
+	memory_used = 0;
+}
+
+/**
+ * The series are transposed to be pixel-major, so the series of two pixels can be walked through
+ * side by side when a pair is counted.
+ */
+void JointFrequencies::setBins(const std::vector<unsigned char*> & binned) {
+	Clear();
+	frame_count = binned.size();
+	series.resize((size_t)p_size * frame_count);
+	for (int t = 0; t < frame_count; ++t) {
+		const unsigned char *frame = binned[t];
+		for (int p = 0; p < p_size; ++p) {
+			series[(size_t)p*frame_count+t] = frame[p];
+		}
+	}
+	sparse = (frame_count < bins_squared / 2);
+}
+
+int JointFrequencies::getJointFrequency(int p0, int bin0, int p1, int bin1) {
+	if (p0 == p1) return 0;
+	if (p0 < p1) { // swap, only upper triangle of matrix is filled, because it is symmetric
+		std::swap(p0, p1);
+		std::swap(bin0, bin1);
+	}
+	Block *block = getBlock(p0 / block_size, p1 / block_size);
+	int pair = (p0 % block_size) * block_size + p1 % block_size;
+	int index = bin0 + bins * bin1;
+	if (!sparse) {
+		if (!block->counts16.empty()) return block->counts16[pair*bins_squared+index];
+		return block->counts32[pair*bins_squared+index];
+	}
+	std::vector<unsigned short>::const_iterator first = block->index.begin() + block->offset[pair];
+	std::vector<unsigned short>::const_iterator last = block->index.begin() + block->offset[pair+1];
+	std::vector<unsigned short>::const_iterator i = std::lower_bound(first, last, index);
+	if (i == last || *i != index) return 0;
+	return block->count[i - block->index.begin()];
+}
+
+void JointFrequencies::getPairFrequencies(int p0, int p1, std::vector<int> & counts) const {
+	counts.assign(bins_squared, 0);
+	if (p0 == p1) return;
+	const unsigned char *s0 = getSeries(p0), *s1 = getSeries(p1);
+	for (int t = 0; t < frame_count; ++t) {
+		counts[s0[t] + bins * s1[t]]++;
+	}
+}
+
+JointFrequencies::Block *JointFrequencies::getBlock(int block0, int block1) {
+	int key = block0 * block_count + block1;
+	std::map<int, Block*>::iterator i = blocks.find(key);
+	if (i != blocks.end()) return i->second;
+
+	Block *block = new Block();
+	calcBlock(block0, block1, *block);
+	blocks[key] = block;
+	order.push_back(key);
+	memory_used += block->bytes;
+
+	// remove the oldest blocks, but never the one just calculated
+	while (memory_used > memory_limit && order.size() > 1) {
+		int oldest = order.front();
+		order.pop_front();
+		Block *old = blocks[oldest];
+		memory_used -= old->bytes;
+		delete old;
+		blocks.erase(oldest);
+	}
+	return block;
+}
+
+/**
+ * All pairs in a block are counted, also the ones that are never asked for (p0 <= p1 in blocks
+ * on the diagonal, and pixels beyond p_size in the last block), they just stay zero.
+ */
+void JointFrequencies::calcBlock(int block0, int block1, Block & block) {
+	int pairs = block_size * block_size;
+	if (!sparse) {
+		bool narrow = (frame_count < 65536);
+		if (narrow) block.counts16.assign((size_t)pairs * bins_squared, 0);
+		else block.counts32.assign((size_t)pairs * bins_squared, 0);
+		for (int i = 0; i < block_size; ++i) {
+			int p0 = block0 * block_size + i;
+			if (p0 >= p_size) break;
+			const unsigned char *s0 = getSeries(p0);
+			for (int j = 0; j < block_size; ++j) {
+				int p1 = block1 * block_size + j;
+				if (p1 >= p0) break;
+				const unsigned char *s1 = getSeries(p1);
+				size_t m = (size_t)(i * block_size + j) * bins_squared;
+				if (narrow) {
+					unsigned short *c = &block.counts16[m];
+					for (int t = 0; t < frame_count; ++t) c[s0[t] + bins * s1[t]]++;
+				} else {
+					int *c = &block.counts32[m];
+					for (int t = 0; t < frame_count; ++t) c[s0[t] + bins * s1[t]]++;
+				}
+			}
+		}
+		block.bytes = block.counts16.size() * sizeof(unsigned short) + block.counts32.size() * sizeof(int);
+		return;
+	}
+
+	// sparse: sort the joint bin indices of a pair and count the runs
+	std::vector<unsigned short> joint(frame_count);
+	block.offset.assign(pairs + 1, 0);
+	for (int pair = 0; pair < pairs; ++pair) {
+		int i = pair / block_size, j = pair % block_size;
+		int p0 = block0 * block_size + i;
+		int p1 = block1 * block_size + j;
+		block.offset[pair] = block.index.size();
+		if (p0 >= p_size || p1 >= p0) continue;
+		const unsigned char *s0 = getSeries(p0), *s1 = getSeries(p1);
+		for (int t = 0; t < frame_count; ++t) joint[t] = s0[t] + bins * s1[t];
+		std::sort(joint.begin(), joint.end());
+		for (int t = 0; t < frame_count; ) {
+			int u = t;
+			while (u < frame_count && joint[u] == joint[t]) ++u;
+			block.index.push_back(joint[t]);
+			block.count.push_back(u - t);
+			t = u;
+		}
+	}
+	block.offset[pairs] = block.index.size();
+	block.bytes = block.offset.size() * sizeof(unsigned int) +
+			(block.index.size() + block.count.size()) * sizeof(unsigned short);
+}
@@ -0,0 +1,160 @@
+/**
+ * @brief
+ * @file MappedDistanceMatrix.cpp
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 11, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+#include <MappedDistanceMatrix.h>
+
+#include <iostream>
+#include <cstring>
+#include <cassert>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+static const char DistanceMatrixMagic[8] = { 'D', 'I', 'S', 'T', 'M', 'A', 'T', 0 };
+static const int DistanceMatrixVersion = 1;
+static const size_t DistanceMatrixPage = 4096;
+
+/* **************************************************************************************
+ * Implementation of MappedDistanceMatrix
+ * **************************************************************************************/
+
+MappedDistanceMatrix::MappedDistanceMatrix(): fd(-1), map(NULL), map_size(0), flags(NULL),
+		data(NULL), sensor_count(0), tile_size(0), tile_count(0) {
+}
+
+MappedDistanceMatrix::~MappedDistanceMatrix() {
+	Close();
+}
+
+/**
+ * The flags start at the second page and the data at the first page after the flags, so tiles
+ * are aligned to pages as long as a tile is a multiple of a page (tile_size 32 or larger).
+ */
+bool MappedDistanceMatrix::Open(const std::string & filename, int sensor_count, int tile_size,
+		unsigned long long key) {
+	assert (sensor_count > 0 && tile_size > 0);
+	Close();
+	this->sensor_count = sensor_count;
+	this->tile_size = tile_size;
+	tile_count = (sensor_count + tile_size - 1) / tile_size;
+
+	Header expected;
+	memset(&expected, 0, sizeof(expected));
+	memcpy(expected.magic, DistanceMatrixMagic, sizeof(expected.magic));
+	expected.version = DistanceMatrixVersion;
+	expected.sensor_count = sensor_count;
+	expected.tile_size = tile_size;
+	expected.tile_count = tile_count;
+	expected.key = key;
+	expected.flags_offset = DistanceMatrixPage;
+	size_t flags_size = getTilePairs();
+	expected.data_offset = DistanceMatrixPage + (flags_size + DistanceMatrixPage - 1) /
+			DistanceMatrixPage * DistanceMatrixPage;
+	expected.file_size = expected.data_offset + (unsigned long long)getTilePairs() * tile_size *
+			tile_size * sizeof(float);
+
+	fd = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		cerr << __func__ << ": could not open " << filename << endl;
+		return false;
+	}
+
+	// reuse the file only if it has been made for exactly the same matrix
+	Header found;
+	bool reuse = (pread(fd, &found, sizeof(found), 0) == (ssize_t)sizeof(found)) &&
+			!memcmp(&found, &expected, sizeof(found));
+	if (!reuse) {
+		// start from scratch, truncating to 0 first makes all flags zero
+		if (ftruncate(fd, 0) || ftruncate(fd, expected.file_size) ||
+				pwrite(fd, &expected, sizeof(expected), 0) != (ssize_t)sizeof(expected)) {
+			cerr << __func__ << ": could not create " << filename << endl;
+			Close();
+			return false;
+		}
+	}
+
+	map_size = expected.file_size;
+	void *m = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (m == MAP_FAILED) {
+		cerr << __func__ << ": could not map " << filename << endl;
+		map_size = 0;
+		Close();
+		return false;
+	}
+	map = (char*)m;
+	flags = (unsigned char*)(map + expected.flags_offset);
+	data = (float*)(map + expected.data_offset);
+	cout << __func__ << ": " << (reuse ? "reuse " : "create ") << filename << " with " <<
+			getTilesDone() << " of " << getTilePairs() << " tiles done" << endl;
+	return true;
+}
+
+void MappedDistanceMatrix::Close() {
+	if (map != NULL) {
+		msync(map, map_size, MS_SYNC);
+		munmap(map, map_size);
+	}
+	if (fd >= 0) close(fd);
+	fd = -1;
+	map = NULL;
+	map_size = 0;
+	flags = NULL;
+	data = NULL;
+}
+
+void MappedDistanceMatrix::Sync() {
+	if (map != NULL) msync(map, map_size, MS_SYNC);
+}
+
+float MappedDistanceMatrix::getDistance(int sensor0, int sensor1) {
+	assert (data != NULL);
+	if (sensor0 == sensor1) return 0;
+	if (sensor0 < sensor1) std::swap(sensor0, sensor1);
+	float *tile = getTile(sensor0 / tile_size, sensor1 / tile_size);
+	return tile[(sensor0 % tile_size) * tile_size + sensor1 % tile_size];
+}
+
+float *MappedDistanceMatrix::getTile(int tile0, int tile1) {
+	assert (tile1 <= tile0 && tile0 < tile_count);
+	return data + tileIndex(tile0, tile1) * tile_size * tile_size;
+}
+
+bool MappedDistanceMatrix::isTileDone(int tile0, int tile1) {
+	assert (tile1 <= tile0 && tile0 < tile_count);
+	return flags[tileIndex(tile0, tile1)] != 0;
+}
+
+void MappedDistanceMatrix::setTileDone(int tile0, int tile1) {
+	assert (tile1 <= tile0 && tile0 < tile_count);
+	flags[tileIndex(tile0, tile1)] = 1;
+}
+
+int MappedDistanceMatrix::getTilesDone() {
+	int done = 0;
+	for (int i = 0; i < getTilePairs(); ++i) done += (flags[i] != 0);
+	return done;
+}
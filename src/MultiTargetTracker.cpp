@@ -0,0 +1,131 @@
+/**
+ * @brief
+ * @file MultiTargetTracker.cpp
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 12, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+#include <MultiTargetTracker.h>
+
+#include <cassert>
+
+using namespace std;
+
+/* **************************************************************************************
+ * Implementation of MultiTargetTracker
+ * **************************************************************************************/
+
+/**
+ * One step of a tick for one target, or for a range of its particles.
+ */
+class TargetTask: public Task {
+public:
+	enum Step { TS_FRAME, TS_TRANSITION, TS_LIKELIHOOD, TS_RESAMPLE };
+	TargetTask(PositionParticleFilter *filter, Step step, int first = 0, int last = 0): filter(filter),
+		step(step), first(first), last(last) {}
+	void Run() {
+		switch (step) {
+		case TS_FRAME: filter->CalcBackProjection(); break;
+		case TS_TRANSITION: filter->Transition(); filter->MeanShift(); break;
+		case TS_LIKELIHOOD: filter->Likelihood(first, last); break;
+		case TS_RESAMPLE: filter->CheckLost(); filter->Resample(); break;
+		}
+	}
+private:
+	PositionParticleFilter *filter;
+	Step step;
+	int first, last;
+};
+
+MultiTargetTracker::MultiTargetTracker(ThreadPool & pool, int chunk_size): pool(pool),
+		chunk_size(chunk_size), bins(16), channels(1), channel_mode(CM_JOINT), integral(NULL) {
+	assert (chunk_size > 0);
+	integral = new IntegralHistogram(bins, channels, channel_mode);
+}
+
+MultiTargetTracker::~MultiTargetTracker() {
+	for (size_t i = 0; i < targets.size(); ++i)
+		delete targets[i];
+	targets.clear();
+	delete integral;
+}
+
+void MultiTargetTracker::SetHistogramConfig(int bins, int channels, ChannelMode channel_mode) {
+	assert (targets.empty());
+	assert (bins > 0 && bins <= 256 && channels > 0);
+	this->bins = bins;
+	this->channels = channels;
+	this->channel_mode = channel_mode;
+	delete integral;
+	integral = new IntegralHistogram(bins, channels, channel_mode);
+}
+
+void MultiTargetTracker::CalcHistogram(CImg<DataValue> & image, NormalizedHistogramValues & result) {
+	DataFrames frames;
+	frames.push_back(image._data);
+	Histogram histogram(bins, image._width, image._height, HM_GLOBAL);
+	histogram.setChannels(std::max(1, std::min<int>(channels, image._spectrum)), channel_mode);
+	histogram.calcProbabilities(frames);
+	histogram.getProbabilities(result);
+}
+
+/**
+ * Every target gets its own seed, so the noise of their motion models is not the same.
+ */
+int MultiTargetTracker::AddTarget(NormalizedHistogramValues & histogram, CImg<CoordValue> & coord,
+		int particle_count) {
+	PositionParticleFilter *filter = new PositionParticleFilter();
+	filter->SetHistogramConfig(bins, channels, channel_mode);
+	filter->SetIntegralHistogram(integral);
+	filter->SetSeed(234789 + 7919 * targets.size());
+	filter->Init(histogram, coord, particle_count);
+	targets.push_back(filter);
+	return targets.size() - 1;
+}
+
+void MultiTargetTracker::Tick(CImg<DataValue> *img, int subticks) {
+	assert (img != NULL);
+	assert (subticks > 0);
+	integral->calcIntegral(img->_data, img->_width, img->_height, img->_spectrum);
+	for (size_t t = 0; t < targets.size(); ++t)
+		targets[t]->SetImage(img);
+
+	TaskGroup group;
+	for (size_t t = 0; t < targets.size(); ++t)
+		pool.Add(new TargetTask(targets[t], TargetTask::TS_FRAME), &group);
+	pool.Wait(group);
+	for (int i = 0; i < subticks; ++i) {
+		for (size_t t = 0; t < targets.size(); ++t)
+			pool.Add(new TargetTask(targets[t], TargetTask::TS_TRANSITION), &group);
+		pool.Wait(group);
+
+		for (size_t t = 0; t < targets.size(); ++t) {
+			int count = targets[t]->GetParticleCount();
+			for (int first = 0; first < count; first += chunk_size) {
+				pool.Add(new TargetTask(targets[t], TargetTask::TS_LIKELIHOOD, first,
+						std::min(first + chunk_size, count)), &group);
+			}
+		}
+		pool.Wait(group);
+
+		for (size_t t = 0; t < targets.size(); ++t)
+			pool.Add(new TargetTask(targets[t], TargetTask::TS_RESAMPLE), &group);
+		pool.Wait(group);
+	}
+}
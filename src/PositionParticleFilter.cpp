@@ -25,6 +25,7 @@
 using namespace dobots;
 
 #include <Print.hpp>
+#include <Timer.hpp>
 
 /* **************************************************************************************
  * Implementation of PositionParticleFilter
@@ -32,21 +33,41 @@ using namespace dobots;
 
 PositionParticleFilter::PositionParticleFilter() {
 	bins = 16;
+	channels = 1;
+	channel_mode = CM_JOINT;
 	seed = 234789;
 	auto_coeff.clear();
 	auto_coeff.push_back(2.0);
 	auto_coeff.push_back(-1.0);
 	srand48(seed);
+	random_number_generator.seed(seed);
 	img = NULL;
+	integral = NULL;
+	last_receive_time = 0;
+	last_step = 0;
+	last_latency = 0;
+	lost_count = 0;
+	reseed_count = 0;
+	aux_subsample = 0;
+	lowres_integral = NULL;
+	scale_variance = 0.001;
+	min_scale = 0.1;
+	max_scale = 4.0;
+	scale_context = 0.25;
+	mean_shift_iterations = 0;
+	backprojection = NULL;
+	likelihood_model = LM_HISTOGRAM;
 }
 
 PositionParticleFilter::~PositionParticleFilter() {
+	delete lowres_integral;
+	delete backprojection;
 
 }
 
 /**
  * Do every action that is necessary to update all particles. This takes three steps:
- * - transition according to a certain motion model
+ * - transition according to a certain motion model (optionally followed by mean-shift)
  * - observing the likelihood of the object being at the translated position (results in a weight)
  * - resample according to that likelihood (given by the weight)
  * @param img_frame			the image with the entitie(s) to be tracked
@@ -55,14 +76,65 @@ PositionParticleFilter::~PositionParticleFilter() {
 void PositionParticleFilter::Tick(CImg<DataValue> *img_frame, int subticks)  {
 	img = img_frame;
 	assert (subticks > 0);
+	bool auxiliary = aux_subsample > 0;
+	if (auxiliary && likelihood_model == LM_HISTOGRAM) CalcLookAhead();
+	CalcBackProjection();
 	for (int i = 0; i < subticks; ++i) {
+		if (auxiliary) {
+			cout << "Select particles that look ahead well" << endl;
+			AuxiliarySelect();
+		}
 		cout << "Transition all particles" << endl;
 		Transition();
+		// the coefficients of Tick(Frame) are for the step into this frame, further subticks are equally spaced
+		if (i == 0) {
+			auto_coeff[0] = 2.0;
+			auto_coeff[1] = -1.0;
+		}
+		if (mean_shift_iterations > 0) MeanShift();
 		cout << "Likelihood for all particles" << endl;
 		Likelihood();
-		cout << "Resample all particles" << endl;
-		Resample();
+		int reseeds = reseed_count;
+		CheckLost();
+		if (auxiliary) {
+			// after a reseed the weights have nothing to do with the look-ahead anymore
+			if (reseed_count == reseeds) AuxiliaryCorrect();
+		} else {
+			cout << "Resample all particles" << endl;
+			Resample();
+		}
+	}
+}
+
+/**
+ * The AR(2) model x[n] = 2 x[n-1] - x[n-2] assumes that the steps are equally spaced in time. The
+ * subticks divide the time since the previous frame in equal steps. With r the length of these
+ * steps divided by the one of the steps of the previous frame, constant velocity means
+ * x[n] = x[n-1] + r (x[n-1] - x[n-2]), so the coefficients of the first step become (1+r) and -r.
+ * The ratio is bounded, so a hiccup in the stream does not throw the particles all over the image.
+ */
+void PositionParticleFilter::Tick(Frame<CImg<DataValue> > &frame, int subticks) {
+	assert (frame.image != NULL);
+	assert (subticks > 0);
+	Value ratio = 1.0;
+	long long step = 0;
+	if (last_receive_time) {
+		step = (frame.receive_time - last_receive_time) / subticks;
+		if (last_step > 0 && step > 0) {
+			ratio = (Value)step / last_step;
+			ratio = std::max<Value>(0.25, std::min<Value>(4.0, ratio));
+		}
 	}
+	last_receive_time = frame.receive_time;
+	last_step = step;
+
+	// Tick sets them back after the first subtick
+	auto_coeff[0] = 1.0 + ratio;
+	auto_coeff[1] = -ratio;
+	Tick(frame.image, subticks);
+
+	last_latency = dobots::get_time_us() - frame.receive_time;
+	latency.Add(last_latency);
 }
 
 /**
@@ -72,6 +144,8 @@ void PositionParticleFilter::Init(NormalizedHistogramValues &tracked_object_hist
 		CImg<CoordValue> &coord, int particle_count) {
 
 	getParticles().clear();
+	last_receive_time = 0;
+	last_step = 0;
 
 	int width = coord(3) - coord(0);
 	int height = coord(4) - coord(1);
@@ -119,43 +193,63 @@ void PositionParticleFilter::Transition() {
 }
 
 void PositionParticleFilter::Likelihood() {
+	Likelihood(0, getParticles().size());
 	std::vector<Particle<ParticleState>* >::iterator i;
-	for (i = getParticles().begin(); i != getParticles().end(); ++i) {
-		ParticleState *state = (*i)->getState();
-		assert (state != NULL);
-		state->likelihood = Likelihood(*state);
-		(*i)->setWeight(state->likelihood);
-	}
 
-	// log for the user
-	std::sort(getParticles().begin(), getParticles().end(), comp_particles<ParticleState>);
-	int max = 10;
+	// log for the user, the particles themselves stay in order (see AuxiliaryCorrect)
+	std::vector<Particle<ParticleState>* > best(std::min<size_t>(10, getParticles().size()));
+	std::partial_sort_copy(getParticles().begin(), getParticles().end(), best.begin(), best.end(),
+			comp_particles<ParticleState>);
 	cout << "Likelihoods: ";
-	for (i = getParticles().begin(); i != getParticles().end(); ++i) {
+	for (i = best.begin(); i != best.end(); ++i) {
 		ParticleState *state = (*i)->getState();
 		cout << '[' << state->getId() << ':' << state->likelihood << "] ";
-		if (--max == 0) break;
 	}
 	cout << endl;
 
 //	ASSERT_EQUAL(getParticles().size(), particle_count);
 }
 
+void PositionParticleFilter::Likelihood(int first, int last) {
+	std::vector<Particle<ParticleState>* > & particles = getParticles();
+	assert (first >= 0 && last <= (int)particles.size());
+	for (int i = first; i < last; ++i) {
+		ParticleState *state = particles[i]->getState();
+		assert (state != NULL);
+		state->likelihood = Likelihood(*state);
+		particles[i]->setWeight(state->likelihood);
+	}
+}
+
 /**
  * Return the particle coordinates for display.
  */
 void PositionParticleFilter::GetParticleCoordinates(std::vector<CImg<CoordValue> *> & coordinates) {
-	// sort to make sure the one with highest weight comes first
-	std::sort(getParticles().begin(), getParticles().end(), comp_particles<ParticleState>);
-
-	std::vector<Particle<ParticleState>* >::iterator i;
-	for (i = getParticles().begin(); i != getParticles().end(); ++i) {
+	int count = getParticles().size();
+	std::vector<CoordValue> rectangles(4 * count);
+	count = GetParticleRectangles(&rectangles[0], count);
+	for (int i = 0; i < count; ++i) {
 		CImg<CoordValue> *coord = new CImg<CoordValue>(6);
-		ParticleState *state = (*i)->getState();
+		coord->_data[0] = rectangles[4*i];
+		coord->_data[1] = rectangles[4*i+1];
+		coord->_data[3] = rectangles[4*i+2];
+		coord->_data[4] = rectangles[4*i+3];
+		coordinates.push_back(coord);
+	}
+}
+
+/**
+ * Only the first max_count particles are put in order, the rest of the particles stays unsorted.
+ */
+int PositionParticleFilter::GetParticleRectangles(CoordValue *rectangles, int max_count) {
+	std::vector<Particle<ParticleState>* > & particles = getParticles();
+	int count = std::min<int>(max_count, particles.size());
+	if (count <= 0) return 0;
+	std::partial_sort(particles.begin(), particles.begin() + count, particles.end(), comp_particles<ParticleState>);
+
+	for (int i = 0; i < count; ++i) {
+		ParticleState *state = particles[i]->getState();
 		assert (state != NULL);
-		assert (state->getId());
-		std::string msg; msg = "state is empty " + state->getId();
-		if(state->x.empty()) cout << msg << endl;
 		assert (!state->x.empty());
 		assert (!state->y.empty());
 		assert (!state->scale.empty());
@@ -164,12 +258,31 @@ void PositionParticleFilter::GetParticleCoordinates(std::vector<CImg<CoordValue>
 		float scale = state->scale.front();
 		float width = state->width * scale;
 		float height = state->height * scale;
-		coord->_data[0] = x-width/2;
-		coord->_data[1] = y-height/2;
-		coord->_data[3] = x+width/2;
-		coord->_data[4] = y+height/2;
-		coordinates.push_back(coord);
+		CoordValue *rectangle = rectangles + 4 * i;
+		rectangle[0] = x-width/2;
+		rectangle[1] = y-height/2;
+		rectangle[2] = x+width/2;
+		rectangle[3] = y+height/2;
 	}
+	return count;
+}
+
+void PositionParticleFilter::StateVector(ParticleState & state, double *vector) {
+	assert (!state.x.empty() && !state.y.empty() && !state.scale.empty());
+	vector[0] = state.x.front();
+	vector[1] = state.y.front();
+	vector[2] = state.scale.front();
+}
+
+void PositionParticleFilter::SetStateVector(ParticleState & state, const double *vector) {
+	assert (!state.x.empty() && !state.y.empty() && !state.scale.empty());
+	Value dx = vector[0] - state.x.front();
+	Value dy = vector[1] - state.y.front();
+	Value dscale = std::max(min_scale, std::min<Value>(max_scale, vector[2])) - state.scale.front();
+	for (size_t i = 0; i < state.x.size(); ++i) state.x[i] += dx;
+	for (size_t i = 0; i < state.y.size(); ++i) state.y[i] += dy;
+	for (size_t i = 0; i < state.scale.size(); ++i)
+		state.scale[i] = std::max(min_scale, std::min(max_scale, state.scale[i] + dscale));
 }
 
 /**
@@ -201,13 +314,16 @@ void PositionParticleFilter::Transition(ParticleState &oldp) {
 
 //#define OVERWRITE
 
-	int xn = dobots::predict(oldp.x.begin(), oldp.x.end(), auto_coeff.begin(), 0.0, 1.0);
-	int yn = dobots::predict(oldp.y.begin(), oldp.y.end(), auto_coeff.begin(), 0.0, 1.0);
-	Value scale = dobots::predict(oldp.scale.begin(), oldp.scale.end(), auto_coeff.begin(), 0.0, 0.001);
+	int xn = dobots::predict(oldp.x.begin(), oldp.x.end(), auto_coeff.begin(), 0.0, 1.0, random_number_generator);
+	int yn = dobots::predict(oldp.y.begin(), oldp.y.end(), auto_coeff.begin(), 0.0, 1.0, random_number_generator);
+	// without the ring around the rectangle nothing holds the scale, so it stays as it is
+	Value scale = oldp.scale.front();
+	if (IsScaleLive())
+		scale = dobots::predict(oldp.scale.begin(), oldp.scale.end(), auto_coeff.begin(), 0.0, (double)scale_variance, random_number_generator);
 
 	xn = std::max(0, std::min((int)img->_width-1, xn));
 	yn = std::max(0, std::min((int)img->_height-1, yn));
-	scale = std::max<Value>(0.1, scale); // scale should not fall below 0.1..
+	scale = std::max(min_scale, std::min(max_scale, scale));
 
 #ifdef OVERWRITE
 	xn = oldp.x[0];
@@ -225,7 +341,6 @@ void PositionParticleFilter::Transition(ParticleState &oldp) {
 	yn += (drand48() * 4 - 2); //epsilon();
 
 #endif
-	scale = 1.0;
 
 	dobots::pushpop(oldp.x.begin(), oldp.x.end(), xn);
 	dobots::pushpop(oldp.y.begin(), oldp.y.end(), yn);
@@ -248,12 +363,7 @@ void PositionParticleFilter::GetLikelihoods(CImg<DataValue> & result, RegionSize
 	assert (img != NULL);
 
 	cout << "Clean entire picture" << endl;
-	for (int i = 0; i < result._width; ++i) {
-		for (int j = 0; j < result._height; ++j) {
-			const DataValue color[] = { 255,255,255 };
-			result.draw_point(i,j,color);
-		}
-	}
+	result.fill(255);
 	cout << "Calculate likelihood for all pixels (except at distance \"width\" from border)" << endl;
 	cout << "  this ranges from " << region_size.width << " to " << result._width-region_size.width << " and ";
 	cout << "from " << region_size.height << " to " << result._height-region_size.height << endl;
@@ -261,6 +371,7 @@ void PositionParticleFilter::GetLikelihoods(CImg<DataValue> & result, RegionSize
 	ParticleState state;
 	state.height = region_size.height;
 	state.width = region_size.width;
+	state.scale.push_back(1);
 
 	bool show_progress = true;
 	if (show_progress) cout << endl;
@@ -283,40 +394,440 @@ void PositionParticleFilter::GetLikelihoods(CImg<DataValue> & result, RegionSize
 }
 
 /**
- * Calculate the likelihood of a player and the state indicated by the parameter
- * "state" which contains an x and y position, a width and a height. This is used
- * to define a rectangle for which a histogram is matched against the reference
- * histogram of the object that is tracked.
- * @param state			the state of the particle (position, width, height)
- * @return				conceptual "distance" to the reference (tracked) object
+ * Likelihoods of a range of positions, run on a thread pool.
  */
-float PositionParticleFilter::Likelihood(ParticleState & state) {
+class ScanTask: public Task {
+public:
+	ScanTask(PositionParticleFilter *filter, RegionSize region_size, const std::vector<int> *positions,
+			std::vector<float> *likelihoods, int begin, int end, long long deadline): filter(filter),
+			region_size(region_size), positions(positions), likelihoods(likelihoods), begin(begin), end(end),
+			deadline(deadline) {}
+	void Run() { filter->CalcLikelihoods(region_size, *positions, *likelihoods, begin, end, deadline); }
+private:
+	PositionParticleFilter *filter;
+	RegionSize region_size;
+	const std::vector<int> *positions;
+	std::vector<float> *likelihoods;
+	int begin, end;
+	long long deadline;
+};
+
+void PositionParticleFilter::CalcLikelihoods(RegionSize region_size, const std::vector<int> & positions,
+		std::vector<float> & likelihoods, int begin, int end, long long deadline) {
+	// not the default constructor, it counts the ids, which is not thread-safe
+	ParticleState state(0);
+	state.width = region_size.width;
+	state.height = region_size.height;
+	state.scale.push_back(1);
+	state.x.push_back(0);
+	state.y.push_back(0);
+	for (int i = begin; i < end; ++i) {
+		if (deadline && dobots::get_time_us() > deadline) break;
+		state.x[0] = positions[2*i];
+		state.y[0] = positions[2*i+1];
+		likelihoods[i] = Likelihood(state);
+	}
+}
+
+/**
+ * Evaluate positions in the ranges given by "bounds" (each range from one bound to the next) on the
+ * pool, or in this thread if there is no pool.
+ */
+static void ScanPositions(PositionParticleFilter *filter, RegionSize region_size, const ScanConfig & config,
+		const std::vector<int> & positions, std::vector<float> & likelihoods, const std::vector<int> & bounds) {
+	ThreadPool *pool = config.pool;
+	likelihoods.assign(positions.size() / 2, 0);
+	TaskGroup group;
+	for (size_t t = 0; t + 1 < bounds.size(); ++t) {
+		if (bounds[t] == bounds[t+1]) continue;
+		if (pool != NULL)
+			pool->Add(new ScanTask(filter, region_size, &positions, &likelihoods, bounds[t], bounds[t+1],
+					config.deadline), &group);
+		else
+			filter->CalcLikelihoods(region_size, positions, likelihoods, bounds[t], bounds[t+1], config.deadline);
+	}
+	if (pool != NULL) pool->Wait(group);
+}
+
+/**
+ * The same range of positions is considered as in GetLikelihoods, the region should fit in the image
+ * at each side. The coarse positions are grouped per tile, and so are the fine positions, which all
+ * lie within the cell of a refined coarse position, from -coarse_step/2 up to coarse_step/2.
+ */
+float PositionParticleFilter::ScanLikelihoods(CImg<float> & map, RegionSize region_size, const ScanConfig & config,
+		int & best_x, int & best_y) {
 	assert (img != NULL);
-	CImg <CoordValue> coord(6);
-	float scale = state.scale.front();
-	scale = 1;
-	coord._data[0] = state.x[0] - scale * state.width/2;
-	coord._data[1] = state.y[0] - scale * state.height/2;
-	coord._data[3] = state.x[0] + scale * state.width/2;
-	coord._data[4] = state.y[0] + scale * state.height/2;
-	CImg <DataValue> img_selection = img->get_crop(coord._data[0], coord._data[1], coord._data[3], coord._data[4]);
+	assert (config.coarse_step > 0 && config.fine_step > 0 && config.tile_size > 0);
+	int width = img->_width, height = img->_height;
+	int coarse = config.coarse_step, fine = config.fine_step;
+	map.assign((width + fine - 1) / fine, (height + fine - 1) / fine, 1, 1, 0);
+	best_x = width / 2;
+	best_y = height / 2;
+	int x_begin = region_size.width, x_end = width - region_size.width;
+	int y_begin = region_size.height, y_end = height - region_size.height;
+	if (x_begin >= x_end || y_begin >= y_end) return 0;
+
+	// coarse grid, tile by tile
+	std::vector<int> positions, bounds;
+	std::vector<float> likelihoods;
+	int tile = std::max(config.tile_size, coarse);
+	for (int ty = y_begin; ty < y_end; ty += tile) {
+		for (int tx = x_begin; tx < x_end; tx += tile) {
+			bounds.push_back(positions.size() / 2);
+			for (int y = ty; y < std::min(ty + tile, y_end); y += coarse) {
+				for (int x = tx; x < std::min(tx + tile, x_end); x += coarse) {
+					positions.push_back(x);
+					positions.push_back(y);
+				}
+			}
+		}
+	}
+	bounds.push_back(positions.size() / 2);
+	ScanPositions(this, region_size, config, positions, likelihoods, bounds);
+
+	float best = 0;
+	for (size_t i = 0; i < likelihoods.size(); ++i) {
+		if (likelihoods[i] > best) {
+			best = likelihoods[i];
+			best_x = positions[2*i];
+			best_y = positions[2*i+1];
+		}
+	}
+
+	// fill the map with the coarse values, and collect the fine positions around the good ones (if there
+	// is time left)
+	std::vector<int> refine, refine_bounds;
+	std::vector<float> refined;
+	float threshold = config.threshold * best;
+	int cells_per_task = std::max(1, (tile / coarse) * (tile / coarse));
+	int refined_cells = 0;
+	for (size_t i = 0; i < likelihoods.size(); ++i) {
+		int cx = positions[2*i], cy = positions[2*i+1];
+		int x0 = std::max(0, cx - coarse / 2), x1 = std::min(width, cx - coarse / 2 + coarse);
+		int y0 = std::max(0, cy - coarse / 2), y1 = std::min(height, cy - coarse / 2 + coarse);
+		for (int y = y0 / fine; y < (y1 + fine - 1) / fine; ++y)
+			for (int x = x0 / fine; x < (x1 + fine - 1) / fine; ++x)
+				map(x, y) = likelihoods[i];
+		if ((fine >= coarse) || (likelihoods[i] < threshold) || (best <= 0)) continue;
+		if (config.deadline && dobots::get_time_us() > config.deadline) continue;
+		if (refined_cells++ % cells_per_task == 0) refine_bounds.push_back(refine.size() / 2);
+		for (int y = std::max(y0, y_begin); y < std::min(y1, y_end); y += fine) {
+			for (int x = std::max(x0, x_begin); x < std::min(x1, x_end); x += fine) {
+				if (x == cx && y == cy) continue;
+				refine.push_back(x);
+				refine.push_back(y);
+			}
+		}
+	}
+	refine_bounds.push_back(refine.size() / 2);
+	ScanPositions(this, region_size, config, refine, refined, refine_bounds);
+
+	for (size_t i = 0; i < refined.size(); ++i) {
+		int x = refine[2*i], y = refine[2*i+1];
+		map(x / fine, y / fine) = refined[i];
+		if (refined[i] > best) {
+			best = refined[i];
+			best_x = x;
+			best_y = y;
+		}
+	}
+	return best;
+}
+
+void PositionParticleFilter::GetLikelihoods(CImg<DataValue> & result, RegionSize region_size, const ScanConfig & config) {
+	CImg<float> map;
+	int best_x, best_y;
+	ScanLikelihoods(map, region_size, config, best_x, best_y);
+	result.fill(255);
+	int fine = config.fine_step;
+	for (int j = 0; j < (int)map._height; ++j) {
+		for (int i = 0; i < (int)map._width; ++i) {
+			DataValue val = map(i, j) * 255;
+			const DataValue color[] = { val,0,0 };
+			result.draw_rectangle(i*fine, j*fine, i*fine+fine-1, j*fine+fine-1, color);
+		}
+	}
+}
+
+void PositionParticleFilter::CheckLost() {
+	if (!redetect_config.enabled || !IsLost()) return;
+	lost_count++;
+	cout << "Track lost, search again" << endl;
+	Redetect();
+}
+
+/**
+ * The weights are the likelihoods of the particles at this moment, they are not normalized.
+ */
+bool PositionParticleFilter::IsLost() {
+	std::vector<Particle<ParticleState>* > & particles = getParticles();
+	if (particles.empty()) return false;
+	double max_weight = 0, total = 0, total_squared = 0;
+	for (size_t i = 0; i < particles.size(); ++i) {
+		double w = particles[i]->getWeight();
+		max_weight = std::max(max_weight, w);
+		total += w;
+		total_squared += w * w;
+	}
+	if (max_weight < redetect_config.min_likelihood) return true;
+	double effective_count = (total_squared > 0) ? total * total / total_squared : 0;
+	return (effective_count < redetect_config.min_effective_ratio * particles.size());
+}
+
+/**
+ * The coarse grid is chosen such that about half of the time budget is needed for it, estimated by
+ * timing the likelihoods of a few particles here. The tick cannot measure it, the MultiTargetTracker
+ * computes the likelihoods in parallel chunks. The fine grid gets a quarter of the coarse step at least.
+ * The deadline takes care of the rest. The particles are put on the best position without velocity
+ * (all history the same), spread over a fine step.
+ */
+bool PositionParticleFilter::Redetect() {
+	std::vector<Particle<ParticleState>* > & particles = getParticles();
+	if (particles.empty() || img == NULL) return false;
+	long long start = dobots::get_time_us();
+	ParticleState *first = particles.front()->getState();
+	// search the object at the size it has now, not the one it had at the start
+	Value scale = GetQuantile(2, 0.5);
+	RegionSize region_size;
+	region_size.width = std::max(1, (int)(scale * first->width));
+	region_size.height = std::max(1, (int)(scale * first->height));
+
+	ScanConfig scan = redetect_config.scan;
+	scan.deadline = start + redetect_config.time_budget;
+	double area = (double)(img->_width - 2 * region_size.width) * (img->_height - 2 * region_size.height);
+	int samples = std::min<int>(particles.size(), 8);
+	for (int i = 0; i < samples; ++i)
+		Likelihood(*particles[i]->getState());
+	long long likelihood_time = dobots::get_time_us() - start;
+	if (likelihood_time > 0 && area > 0) {
+		double per_position = (double)likelihood_time / samples;
+		double affordable = redetect_config.time_budget / (2 * per_position);
+		if (affordable >= 1) {
+			int step = (int)std::ceil(std::sqrt(area / affordable));
+			scan.coarse_step = std::max(scan.coarse_step, step);
+		}
+	}
+	scan.fine_step = std::max(scan.fine_step, scan.coarse_step / 4);
+
+	CImg<float> map;
+	int best_x, best_y;
+	float best = ScanLikelihoods(map, region_size, scan, best_x, best_y);
+	cout << __func__ << ": best position [" << best_x << ',' << best_y << "] (" << best << ") in "
+			<< dobots::get_time_us() - start << " us" << endl;
+
+	double max_weight = 0;
+	for (size_t i = 0; i < particles.size(); ++i)
+		max_weight = std::max(max_weight, particles[i]->getWeight());
+	if (best <= max_weight) return false;
+
+	int spread = scan.fine_step;
+	for (size_t i = 0; i < particles.size(); ++i) {
+		ParticleState *state = particles[i]->getState();
+		int x = best_x + (int)(random_number_generator() % (spread + 1)) - spread / 2;
+		int y = best_y + (int)(random_number_generator() % (spread + 1)) - spread / 2;
+		std::fill(state->x.begin(), state->x.end(), x);
+		std::fill(state->y.begin(), state->y.end(), y);
+		std::fill(state->scale.begin(), state->scale.end(), scale);
+		state->likelihood = best;
+		particles[i]->setWeight(1);
+	}
+	reseed_count++;
+	return true;
+}
+
+void PositionParticleFilter::SetHistogramConfig(int bins, int channels, ChannelMode channel_mode) {
+	assert (bins > 0 && bins <= 256 && channels > 0);
+	this->bins = bins;
+	this->channels = channels;
+	this->channel_mode = channel_mode;
+	delete lowres_integral;
+	lowres_integral = NULL;
+	delete backprojection;
+	backprojection = NULL;
+}
+
+void PositionParticleFilter::SetMeanShift(int iterations) {
+	assert (iterations >= 0);
+	mean_shift_iterations = iterations;
+}
+
+/**
+ * Only the current position is moved, the history stays, so the move counts as velocity in the next
+ * Transition.
+ */
+void PositionParticleFilter::MeanShift() {
+	if (!mean_shift_iterations) return;
+	assert (backprojection != NULL);
+	std::vector<Particle<ParticleState>* > & particles = getParticles();
+	for (size_t i = 0; i < particles.size(); ++i) {
+		ParticleState *state = particles[i]->getState();
+		float x = state->x.front(), y = state->y.front();
+		float scale = state->scale.front();
+		backprojection->meanShift(x, y, state->width * scale, state->height * scale, mean_shift_iterations);
+		state->x.front() = x;
+		state->y.front() = y;
+	}
+}
+
+void PositionParticleFilter::SetScaleModel(Value variance, Value min_scale, Value max_scale, Value context) {
+	assert (variance >= 0 && min_scale > 0 && min_scale <= max_scale && context >= 0);
+	scale_variance = variance;
+	this->min_scale = min_scale;
+	this->max_scale = max_scale;
+	scale_context = context;
+}
+
+void PositionParticleFilter::SetAuxiliary(int subsample) {
+	assert (subsample >= 0);
+	aux_subsample = subsample;
+}
+
+void PositionParticleFilter::SetLikelihoodModel(LikelihoodModel model) {
+	likelihood_model = model;
+}
+
+void PositionParticleFilter::CalcBackProjection() {
+	if (!mean_shift_iterations && likelihood_model != LM_BACKPROJECTION) return;
+	assert (img != NULL);
+	if (backprojection == NULL) backprojection = new BackProjection(bins, channels, channel_mode);
+	backprojection->calcBackProjection(tracked_object_histogram, img->_data, img->_width, img->_height, img->_spectrum);
+}
+
+/**
+ * Every subsample-th pixel in both directions is taken, rather than averaging blocks of pixels, so
+ * the colours (and with that the histograms) stay the same as in the full image.
+ */
+void PositionParticleFilter::CalcLookAhead() {
+	assert (img != NULL && aux_subsample > 0);
+	if (lowres_integral == NULL)
+		lowres_integral = new IntegralHistogram(bins, channels, channel_mode);
+	int k = aux_subsample;
+	int width = std::max(1, (int)img->_width / k);
+	int height = std::max(1, (int)img->_height / k);
+	int spectrum = img->_spectrum;
+	lowres_image.assign(width, height, 1, spectrum, 0);
+	for (int c = 0; c < spectrum; ++c) {
+		for (int y = 0; y < height; ++y) {
+			const DataValue *src = img->_data + ((size_t)c * img->_height + y * k) * img->_width;
+			DataValue *dest = lowres_image._data + ((size_t)c * height + y) * width;
+			for (int x = 0; x < width; ++x) dest[x] = src[x * k];
+		}
+	}
+	lowres_integral->calcIntegral(lowres_image._data, width, height, spectrum);
+}
+
+/**
+ * The expected position is the one of the AR model without noise. The rectangle is scaled down to
+ * the subsampled image, the histogram from the integral histogram takes the same time for any size.
+ */
+double PositionParticleFilter::LookAhead(ParticleState & state) {
+	Value x = std::inner_product(state.x.begin(), state.x.end(), auto_coeff.begin(), Value(0));
+	Value y = std::inner_product(state.y.begin(), state.y.end(), auto_coeff.begin(), Value(0));
+	Value scale = std::inner_product(state.scale.begin(), state.scale.end(), auto_coeff.begin(), Value(0));
+	scale = std::max(min_scale, std::min(max_scale, scale));
+	if (likelihood_model == LM_BACKPROJECTION)
+		return BackProjectionLikelihood(x, y, state.width * scale, state.height * scale);
+	assert (lowres_integral != NULL);
+	Value k = aux_subsample;
+	return Likelihood(lowres_integral, x / k, y / k, state.width * scale / k, state.height * scale / k);
+}
+
+/**
+ * The image is used as is, no copy is made. If the image has less colour planes than configured,
+ * only the ones it has are used, so it does not matter if a grey-scale image is tracked.
+ */
+void PositionParticleFilter::CalcHistogram(CImg<DataValue> & image, NormalizedHistogramValues & result) {
 	DataFrames frames;
-	frames.clear();
-	pDataMatrix data = img_selection._data;
-	frames.push_back(data);
+	frames.push_back(image._data);
 
-	Histogram histogram(bins, img_selection._width, img_selection._height);
+	Histogram histogram(bins, image._width, image._height, HM_GLOBAL);
+	histogram.setChannels(std::max(1, std::min<int>(channels, image._spectrum)), channel_mode);
 #ifdef VERBOSE
 	cout << __func__ << ": Add data for histograms" << endl;
 #endif
-	assert (frames.size() == 1);
 	histogram.calcProbabilities(frames);
 
 #ifdef VERBOSE
 	cout << __func__ << ": Get normalized probabilities" << endl;
 #endif
-	NormalizedHistogramValues result;
 	histogram.getProbabilities(result);
+}
+
+/**
+ * With an integral histogram the part of the rectangle outside of the image is ignored, a crop of
+ * the image counts it as black pixels (like it always did).
+ */
+int PositionParticleFilter::RegionHistogram(const IntegralHistogram *source, int x0, int y0, int x1, int y1,
+		NormalizedHistogramValues & result) {
+	if (source != NULL) {
+		source->getProbabilities(x0, y0, x1, y1, result);
+		int width = std::min(x1, source->getWidth() - 1) - std::max(x0, 0) + 1;
+		int height = std::min(y1, source->getHeight() - 1) - std::max(y0, 0) + 1;
+		return (width > 0 && height > 0) ? width * height : 0;
+	}
+	CImg <DataValue> img_selection = img->get_crop(x0, y0, x1, y1);
+	CalcHistogram(img_selection, result);
+	return img_selection._width * img_selection._height;
+}
+
+/**
+ * Calculate the likelihood of a player and the state indicated by the parameter
+ * "state" which contains an x and y position, a width and a height. This is used
+ * to define a rectangle for which a histogram is matched against the reference
+ * histogram of the object that is tracked.
+ *
+ * Any rectangle within the object matches just as well as the one around the object, so with the
+ * rectangle alone the scale would shrink. Hence the ring around the rectangle (see SetScaleModel)
+ * is compared too, and it should not look like the object. Its histogram is the one of the larger
+ * rectangle minus the one of the rectangle itself. How much the ring counts depends on how well the
+ * rectangle matches, so that rectangles that only partly cover the object are not punished twice.
+ * @param state			the state of the particle (position, width, height)
+ * @return				conceptual "distance" to the reference (tracked) object
+ */
+float PositionParticleFilter::Likelihood(ParticleState & state) {
+	assert (img != NULL);
+	float scale = state.scale.front();
+	if (likelihood_model == LM_BACKPROJECTION)
+		return BackProjectionLikelihood(state.x[0], state.y[0], scale * state.width, scale * state.height);
+	return Likelihood(integral, state.x[0], state.y[0], scale * state.width, scale * state.height);
+}
+
+/**
+ * The mean weight of the rectangle plays the role of the similarity of the histograms, the mean
+ * weight of the ring the one of the ring (see Likelihood with an integral histogram).
+ */
+float PositionParticleFilter::BackProjectionLikelihood(Value x, Value y, Value width, Value height) {
+	assert (backprojection != NULL);
+	int x0 = x - width/2, y0 = y - height/2, x1 = x + width/2, y1 = y + height/2;
+	int w = std::min(x1, backprojection->getWidth() - 1) - std::max(x0, 0) + 1;
+	int h = std::min(y1, backprojection->getHeight() - 1) - std::max(y0, 0) + 1;
+	if (w <= 0 || h <= 0) return std::exp(-20.0);
+	int count = w * h;
+	double sum = backprojection->getSum(x0, y0, x1, y1);
+	Value inside = sum / count;
+	Value dist = 1 - inside;
+	if (scale_context > 0) {
+		int mx = std::max(1, (int)(scale_context * width));
+		int my = std::max(1, (int)(scale_context * height));
+		int ow = std::min(x1 + mx, backprojection->getWidth() - 1) - std::max(x0 - mx, 0) + 1;
+		int oh = std::min(y1 + my, backprojection->getHeight() - 1) - std::max(y0 - my, 0) + 1;
+		int outer_count = ow * oh;
+		if (outer_count > count) {
+			double ring = (backprojection->getSum(x0 - mx, y0 - my, x1 + mx, y1 + my) - sum) / (outer_count - count);
+			dist += ring * inside;
+		}
+	}
+	return std::exp(-20.0 * dist);
+}
+
+float PositionParticleFilter::Likelihood(const IntegralHistogram *source, Value x, Value y, Value width, Value height) {
+	CImg <CoordValue> coord(6);
+	coord._data[0] = x - width/2;
+	coord._data[1] = y - height/2;
+	coord._data[3] = x + width/2;
+	coord._data[4] = y + height/2;
+	NormalizedHistogramValues result;
+	int count = RegionHistogram(source, coord._data[0], coord._data[1], coord._data[3], coord._data[4], result);
 
 #ifdef VERBOSE
 	cout << __func__ << ": Calculate distance to histogram of the to-be-tracked object" << endl;
@@ -324,6 +835,21 @@ float PositionParticleFilter::Likelihood(ParticleState & state) {
 
 	Value dist = dobots::distance<Value>(tracked_object_histogram.begin(), tracked_object_histogram.end(), result.begin(), result.end(),
 			dobots::DM_SQUARED_HELLINGER);
+	// without an integral histogram the ring would cost a second crop of the image per particle
+	if (scale_context > 0 && count > 0 && source != NULL) {
+		int mx = std::max(1, (int)(scale_context * width));
+		int my = std::max(1, (int)(scale_context * height));
+		NormalizedHistogramValues outer;
+		int outer_count = RegionHistogram(source, coord._data[0] - mx, coord._data[1] - my, coord._data[3] + mx,
+				coord._data[4] + my, outer);
+		if (outer_count > count) {
+			for (size_t i = 0; i < outer.size(); ++i)
+				outer[i] = std::max<Value>(0, (outer[i] * outer_count - result[i] * count) / (outer_count - count));
+			Value ring_dist = dobots::distance<Value>(tracked_object_histogram.begin(), tracked_object_histogram.end(),
+					outer.begin(), outer.end(), dobots::DM_SQUARED_HELLINGER);
+			dist += (1 - ring_dist) * (1 - dist);
+		}
+	}
 	return std::exp(-20.0 * dist);
 }
 
@@ -23,22 +23,65 @@
 
 #include <ProbMatrix.h>
 #include <stddef.h>
+#include <cassert>
 
 /* **************************************************************************************
  * Implementation of ProbMatrix
  * **************************************************************************************/
 
-ProbMatrix::ProbMatrix(int bins, int width, int height): bins(bins),
+ProbMatrix::ProbMatrix(int bins, int width, int height, HistogramMode mode): bins(bins),
 	p_height(height),
 	p_width(width),
 	p_size(height * width),
 	bins_squared(bins*bins),
 	freq(NULL),
 	joint_freq(NULL),
+	global_freq(NULL),
+	mode(mode),
+	channels(1),
+	channel_mode(CM_JOINT),
 	frame_count(0) {
-
+	calcBinTable();
 }
 
 ProbMatrix::~ProbMatrix() {
 
 }
+
+void ProbMatrix::setChannels(int channels, ChannelMode channel_mode) {
+	assert (channels > 0);
+	assert (channels == 1 || mode == HM_GLOBAL);
+	this->channels = channels;
+	this->channel_mode = channel_mode;
+	calcBinTable();
+}
+
+int ProbMatrix::getHistogramSize() {
+	if (channel_mode == CM_CONCATENATED) return channels * bins;
+	int size = 1;
+	for (int c = 0; c < channels; ++c) size *= bins;
+	return size;
+}
+
+/**
+ * Uniformly divides the bins over the range [0,255], the same as Histogram::value2bin. The
+ * channel tables have the offset of the channel in the histogram already added (concatenated) or
+ * the stride multiplied in (joint), so the index in the histogram of a pixel is just the sum
+ * of the lookups of its channel values.
+ */
+void ProbMatrix::calcBinTable() {
+	for (int v = 0; v < 256; ++v) {
+		bin_table[v] = (v * bins) / 256;
+	}
+	channel_table.resize(channels * 256);
+	int stride = 1;
+	for (int c = 0; c < channels; ++c) {
+		for (int v = 0; v < 256; ++v) {
+			if (channel_mode == CM_CONCATENATED)
+				channel_table[c*256+v] = c * bins + bin_table[v];
+			else
+				channel_table[c*256+v] = bin_table[v] * stride;
+		}
+		stride *= bins;
+	}
+}
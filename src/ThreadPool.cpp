@@ -0,0 +1,169 @@
+/**
+ * @brief
+ * @file ThreadPool.cpp
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 3, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+#include <ThreadPool.h>
+
+#include <unistd.h>
+#include <cassert>
+
+/* **************************************************************************************
+ * Implementation of TaskGroup
+ * **************************************************************************************/
+
+TaskGroup::TaskGroup(): pending(0) {
+	pthread_mutex_init(&mutex, NULL);
+	pthread_cond_init(&done, NULL);
+}
+
+TaskGroup::~TaskGroup() {
+	assert (pending == 0);
+	pthread_cond_destroy(&done);
+	pthread_mutex_destroy(&mutex);
+}
+
+int TaskGroup::Pending() {
+	pthread_mutex_lock(&mutex);
+	int result = pending;
+	pthread_mutex_unlock(&mutex);
+	return result;
+}
+
+/* **************************************************************************************
+ * Implementation of ThreadPool
+ * **************************************************************************************/
+
+ThreadPool::ThreadPool(int thread_count): stopping(false) {
+	pthread_mutex_init(&mutex, NULL);
+	pthread_cond_init(&available, NULL);
+	if (thread_count <= 0) thread_count = GetProcessorCount();
+	for (int i = 0; i < thread_count; ++i) {
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, ThreadPool::Work, this) == 0)
+			threads.push_back(thread);
+	}
+	assert (!threads.empty());
+}
+
+/**
+ * The remaining tasks are still executed, the workers only quit on an empty queue.
+ */
+ThreadPool::~ThreadPool() {
+	pthread_mutex_lock(&mutex);
+	stopping = true;
+	pthread_cond_broadcast(&available);
+	pthread_mutex_unlock(&mutex);
+	for (size_t i = 0; i < threads.size(); ++i) {
+		pthread_join(threads[i], NULL);
+	}
+	threads.clear();
+	pthread_cond_destroy(&available);
+	pthread_mutex_destroy(&mutex);
+}
+
+void ThreadPool::Add(Task *task, TaskGroup *group) {
+	assert (task != NULL);
+	if (group != NULL) {
+		pthread_mutex_lock(&group->mutex);
+		group->pending++;
+		pthread_mutex_unlock(&group->mutex);
+	}
+	Item item;
+	item.task = task;
+	item.group = group;
+	pthread_mutex_lock(&mutex);
+	queue.push_back(item);
+	pthread_cond_signal(&available);
+	pthread_mutex_unlock(&mutex);
+}
+
+/**
+ * While the group is not finished, run tasks from the queue (of any group). If the queue is
+ * empty, the remaining tasks of the group are being run by other threads, so we can sleep
+ * till the last one signals us.
+ */
+void ThreadPool::Wait(TaskGroup &group) {
+	while (true) {
+		pthread_mutex_lock(&group.mutex);
+		bool finished = (group.pending == 0);
+		pthread_mutex_unlock(&group.mutex);
+		if (finished) return;
+
+		pthread_mutex_lock(&mutex);
+		if (!queue.empty()) {
+			Item item = queue.front();
+			queue.pop_front();
+			pthread_mutex_unlock(&mutex);
+			Execute(item.task, item.group);
+			continue;
+		}
+		pthread_mutex_unlock(&mutex);
+
+		pthread_mutex_lock(&group.mutex);
+		if (group.pending != 0) {
+			pthread_cond_wait(&group.done, &group.mutex);
+		}
+		pthread_mutex_unlock(&group.mutex);
+	}
+}
+
+int ThreadPool::GetQueueSize() {
+	pthread_mutex_lock(&mutex);
+	int result = queue.size();
+	pthread_mutex_unlock(&mutex);
+	return result;
+}
+
+int ThreadPool::GetProcessorCount() {
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int)count : 1;
+}
+
+void *ThreadPool::Work(void *p) {
+	ThreadPool *pool = (ThreadPool*)p;
+	while (true) {
+		pthread_mutex_lock(&pool->mutex);
+		while (pool->queue.empty() && !pool->stopping) {
+			pthread_cond_wait(&pool->available, &pool->mutex);
+		}
+		if (pool->queue.empty()) {
+			pthread_mutex_unlock(&pool->mutex);
+			break;
+		}
+		Item item = pool->queue.front();
+		pool->queue.pop_front();
+		pthread_mutex_unlock(&pool->mutex);
+		pool->Execute(item.task, item.group);
+	}
+	return NULL;
+}
+
+void ThreadPool::Execute(Task *task, TaskGroup *group) {
+	task->Run();
+	delete task;
+	if (group == NULL) return;
+	pthread_mutex_lock(&group->mutex);
+	if (--group->pending == 0) {
+		pthread_cond_broadcast(&group->done);
+	}
+	pthread_mutex_unlock(&group->mutex);
+}
@@ -42,6 +42,13 @@
 #include <testConvolution.h>
 #include <createTrackImage.h>
 #include <createImages.h>
+#include <testIpcamStream.h>
+#include <testHistogramSpeed.h>
+#include <testCrutchfield.h>
+#include <testIntegralHistogram.h>
+#include <testRaoBlackwellized.h>
+#include <testBackProjection.h>
+#include <testPositionFilter.h>
 
 using namespace cimg_library;
 using namespace std;
@@ -61,7 +68,7 @@ void getHistogram(CImg<T> &img, NormalizedHistogramValues & result) {
 	int bins = 16;
 
 	cout << "Create histogram with " << bins << " bins" << endl;
-	Histogram histogram(bins, width, height);
+	Histogram histogram(bins, width, height, HM_GLOBAL);
 	DataFrames frames;
 	pDataMatrix data = img._data;
 	frames.push_back(data);
@@ -87,6 +94,20 @@ int main() {
 //	test_distance();
 //	create_track_image();
 //	test_convolution();
+//	test_ipcam_stream();
+//	test_histogram_speed();
+//	test_joint_frequencies();
+//	test_crutchfield_distances();
+//	test_crutchfield_window();
+//	test_mapped_distances();
+//	test_integral_histogram();
+//	test_rao_blackwellized();
+//	test_back_projection();
+//	test_scan_likelihoods();
+//	test_redetection();
+//	test_multi_target_tracker();
+//	test_scale_estimation();
+//	test_fixed_scale();
 	create_images();
 	return EXIT_SUCCESS;
 
@@ -123,7 +144,7 @@ int main() {
 	ImageType &track_img = *track.getImage(track_fn);
 
 	NormalizedHistogramValues result;
-	getHistogram(track_img, result);
+	filter.CalcHistogram(track_img, result);
 
 	string config = path + '/' + fn + ".ini";
 	cout << "Load config file: " << config << endl;
@@ -139,7 +160,9 @@ int main() {
 	int shift = 4;
 	filter.Init(result, img_coords, particles);
 
-	vector <CImg<CoordValue>*> coordinates;
+	// only the rectangles of the best particles are drawn
+	const int max_rectangles = 10;
+	CoordValue rectangles[4*max_rectangles];
 
 	int frame_count = 40;
 	int frame_id = 0;
@@ -154,22 +177,16 @@ int main() {
 //		return 1;
 #endif
 
-		cout << "Clear coordinates" << endl;
-		coordinates.erase(coordinates.begin(), coordinates.end());
-		coordinates.clear();
-		filter.GetParticleCoordinates(coordinates);
-
-		CImg<DataValue> &img_copy = *new CImg<DataValue>(img);
-		int max = 10;
-		for (int i = 0; i < coordinates.size(); ++i) {
-			CImg<CoordValue>* coord = coordinates[i];
-			//cout << "Draw rectangle at: [" << coord->_data[0] << "," << coord->_data[1] << "," << coord->_data[3] << "," << coord->_data[4] << "]" << endl;
-			float opacity = 0.05;
-			img_copy.draw_line(coord->_data[0], coord->_data[1], coord->_data[0], coord->_data[4], red);
-			img_copy.draw_line(coord->_data[0], coord->_data[1], coord->_data[3], coord->_data[1], red);
-			img_copy.draw_line(coord->_data[3], coord->_data[1], coord->_data[3], coord->_data[4], red);
-			img_copy.draw_line(coord->_data[0], coord->_data[4], coord->_data[3], coord->_data[4], red);
-			if (--max == 0) break;
+		int count = filter.GetParticleRectangles(rectangles, max_rectangles);
+
+		CImg<DataValue> img_copy(img);
+		for (int i = 0; i < count; ++i) {
+			CoordValue *coord = rectangles + 4 * i;
+			//cout << "Draw rectangle at: [" << coord[0] << "," << coord[1] << "," << coord[2] << "," << coord[3] << "]" << endl;
+			img_copy.draw_line(coord[0], coord[1], coord[0], coord[3], red);
+			img_copy.draw_line(coord[0], coord[1], coord[2], coord[1], red);
+			img_copy.draw_line(coord[2], coord[1], coord[2], coord[3], red);
+			img_copy.draw_line(coord[0], coord[3], coord[2], coord[3], red);
 		}
 
 		CImgDisplay main_disp(img_copy, "Show image");
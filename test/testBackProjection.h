@@ -0,0 +1,78 @@
+/**
+ * @brief Test of the back-projection of a histogram and of mean-shift on it
+ * @file testBackProjection.h
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 18, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+#include <Histogram.h>
+#include <BackProjection.h>
+
+#include <iostream>
+#include <cassert>
+#include <cmath>
+
+using namespace std;
+
+/**
+ * A red square on a grey background: the pixels of the square get weight one, the others zero, the
+ * sums of rectangles count the pixels of the square in them, and mean-shift from a rectangle that
+ * only partly covers the square ends up at its centre.
+ */
+void test_back_projection() {
+	cout << " === start test back projection === " << endl;
+	int width = 60, height = 40, spectrum = 3;
+	std::vector<DataValue> image(width * height * spectrum, 128);
+	for (int y = 10; y < 20; ++y) {
+		for (int x = 30; x < 40; ++x) {
+			image[y * width + x] = 250;
+			image[(height + y) * width + x] = 10;
+			image[(2 * height + y) * width + x] = 10;
+		}
+	}
+	// the histogram of the object is taken from a copy of the square
+	std::vector<DataValue> object(10 * 10 * spectrum);
+	for (int c = 0; c < spectrum; ++c)
+		for (int i = 0; i < 100; ++i)
+			object[c * 100 + i] = image[(c * height + 10 + i / 10) * width + 30 + i % 10];
+
+	for (int config = 0; config < 2; ++config) {
+		ChannelMode channel_mode = (config == 0) ? CM_JOINT : CM_CONCATENATED;
+		DataFrames frames;
+		frames.push_back(&object[0]);
+		Histogram histogram(8, 10, 10, HM_GLOBAL);
+		histogram.setChannels(spectrum, channel_mode);
+		histogram.calcProbabilities(frames);
+		NormalizedHistogramValues target;
+		histogram.getProbabilities(target);
+
+		BackProjection backprojection(8, spectrum, channel_mode);
+		backprojection.calcBackProjection(target, &image[0], width, height, spectrum);
+		assert (backprojection.getWeight(35, 15) == 1 && backprojection.getWeight(5, 5) == 0);
+		assert (backprojection.getSum(0, 0, width - 1, height - 1) == 100);
+		assert (backprojection.getSum(35, 15, 70, 50) == 25 && backprojection.getSum(-5, -5, 29, 39) == 0);
+
+		float x = 30, y = 12;
+		int iterations = backprojection.meanShift(x, y, 12, 12, 10, 0.1);
+		cout << "Mean-shift (" << (channel_mode == CM_JOINT ? "joint" : "concatenated") << ") to [" << x << ','
+				<< y << "] in " << iterations << " iterations (should be [34.5,14.5])" << endl;
+		assert (std::abs(x - 34.5) < 0.5 && std::abs(y - 14.5) < 0.5);
+	}
+	cout << " === end test back projection === " << endl;
+}
@@ -28,6 +28,8 @@
 #include <Container.hpp>
 #include <Print.hpp>
 
+#include <cassert>
+
 using namespace dobots;
 using namespace std;
 
@@ -72,6 +74,48 @@ void test_convolution() {
 
 	cout << "Vector 2: ";
 	print(vec2.begin(), vec2.end());
+
+	clean(vec3.begin(), vec3.end());
+	circular_convolution_copy(vec1.begin(), vec1.end(), vec2.begin(), vec2.end(), vec3.begin(), 1);
+	cout << "Circular convolution (copy): ";
+	print(vec3.begin(), vec3.end());
+
+	// larger containers go through the fast Fourier transform, compare with rotating explicitly
+	int sizes[] = { 100, 127, 128, 200, 256 };
+	for (int s = 0; s < 5; ++s) {
+		size = sizes[s];
+		std::vector<int> a(size), b(size), expected, fast(size), fast_copy(size);
+		for (int i = 0; i < size; ++i) {
+			a[i] = (i * 7919) % 201 - 100;
+			b[i] = (i * 104729) % 101 - 50;
+		}
+		for (int shift = 1; shift < 4; ++shift) {
+			std::vector<int> rotated(b);
+			expected.clear();
+			for (int i = 0; i < size; ++i) {
+				std::rotate(rotated.begin(), rotated.end()-shift, rotated.end());
+				expected.push_back(reverse_inner_product(a.begin(), a.end(), rotated.end(), 0));
+			}
+			std::vector<int> original(b);
+			circular_convolution(a.begin(), a.end(), b.begin(), b.end(), fast.begin(), shift);
+			circular_convolution_copy(a.begin(), a.end(), b.begin(), b.end(), fast_copy.begin(), shift);
+			assert (fast == expected);
+			assert (fast_copy == expected);
+			assert (b == original);
+		}
+		cout << "Circular convolution of size " << size << " equal to the direct calculation" << endl;
+	}
+
+	// a size that is not a power of two, forward and back should give the original
+	std::vector<std::complex<double> > sequence(12);
+	for (int i = 0; i < 12; ++i)
+		sequence[i] = std::complex<double>(i % 5, i % 3);
+	std::vector<std::complex<double> > transformed(sequence);
+	fft(transformed);
+	fft(transformed, true);
+	for (int i = 0; i < 12; ++i)
+		assert (std::abs(transformed[i] - sequence[i]) < 1e-9);
+	cout << "Fourier transform of size 12 and back gives the original" << endl;
 }
 
 #endif /* TESTCONVOLUTION_H_ */
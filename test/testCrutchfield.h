@@ -0,0 +1,224 @@
+/**
+ * @brief Tests for the Crutchfield distance between pixels
+ * @file testCrutchfield.h
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 9, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+#include <Crutchfield.h>
+#include <JointFrequencies.h>
+#include <MappedDistanceMatrix.h>
+#include <Timer.hpp>
+
+#include <iostream>
+#include <cstdlib>
+#include <cassert>
+#include <cmath>
+#include <unistd.h>
+
+using namespace std;
+
+/**
+ * Random frames, where the right half of the image is a noisy copy of the left half, so there
+ * is something to find.
+ */
+DataFrames create_crutchfield_frames(int width, int height, int frame_count) {
+	DataFrames frames;
+	for (int t = 0; t < frame_count; ++t) {
+		pDataMatrix data = new DataValue[width*height];
+		for (int y = 0; y < height; ++y) {
+			for (int x = 0; x < width/2; ++x) {
+				DataValue v = (DataValue)(drand48() * 256);
+				data[y*width+x] = v;
+				data[y*width+x+width/2] = (drand48() < 0.8) ? v : (DataValue)(drand48() * 256);
+			}
+		}
+		frames.push_back(data);
+	}
+	return frames;
+}
+
+void delete_crutchfield_frames(DataFrames & frames) {
+	for (size_t t = 0; t < frames.size(); ++t) delete [] frames[t];
+	frames.clear();
+}
+
+/**
+ * Compares the joint frequencies (dense and sparse) with counting them by hand.
+ */
+void test_joint_frequencies() {
+	cout << " === start test joint frequencies === " << endl;
+	srand48(4321);
+	int width = 10, height = 7, p_size = width * height;
+	int bins = 8;
+	for (int i = 0; i < 2; ++i) {
+		// 16 frames are stored sparse (16 < 8*8/2), 64 frames dense
+		int frame_count = (i == 0) ? 16 : 64;
+		DataFrames frames = create_crutchfield_frames(width, height, frame_count);
+		Histogram histogram(bins, width, height);
+		histogram.calcProbabilities(frames);
+
+		int errors = 0;
+		for (int p0 = 0; p0 < p_size; ++p0) {
+			for (int p1 = 0; p1 < p_size; ++p1) {
+				std::vector<int> counts(bins*bins, 0);
+				if (p0 != p1) {
+					for (int t = 0; t < frame_count; ++t) {
+						counts[histogram.value2bin(frames[t][p0]) + bins * histogram.value2bin(frames[t][p1])]++;
+					}
+				}
+				for (int b0 = 0; b0 < bins; ++b0) {
+					for (int b1 = 0; b1 < bins; ++b1) {
+						if (histogram.getJointFrequency(p0, b0, p1, b1) != counts[b0 + bins*b1]) errors++;
+					}
+				}
+			}
+		}
+		cout << "Joint frequencies for " << frame_count << " frames: " << errors << " errors" << endl;
+		assert (errors == 0);
+		delete_crutchfield_frames(frames);
+	}
+	cout << " === end test joint frequencies === " << endl;
+}
+
+/**
+ * Compares the tiled, parallel distance calculation with the conditional entropies per pair,
+ * and shows the time it takes.
+ */
+void test_crutchfield_distances(int width = 16, int height = 12, int frame_count = 100) {
+	cout << " === start test crutchfield distances === " << endl;
+	srand48(1234);
+	int p_size = width * height;
+	int bins = 8;
+	DataFrames frames = create_crutchfield_frames(width, height, frame_count);
+	Crutchfield crutchfield(bins, width, height);
+	crutchfield.calcProbabilities(frames);
+
+	dobots::Timer timer;
+	crutchfield.calcDistances(0, 16);
+	long long parallel_time = timer.Elapsed();
+
+	timer.Reset();
+	Value max_error = 0, left_right = 0, left_left = 0;
+	for (int p0 = 0; p0 < p_size; ++p0) {
+		for (int p1 = 0; p1 < p_size; ++p1) {
+			Value d = crutchfield.calcDistance(p0, p1);
+			max_error = std::max(max_error, std::fabs(d - crutchfield.getDistance(p0, p1)));
+		}
+	}
+	long long serial_time = timer.Elapsed();
+
+	// a pixel and its noisy copy in the other half should be closer than two unrelated pixels
+	left_right = crutchfield.getDistance(0, width/2);
+	left_left = crutchfield.getDistance(0, 1);
+	cout << "Distance to copy " << left_right << ", to neighbour " << left_left << endl;
+	cout << "Maximum difference with calcDistance per pair " << max_error << endl;
+	cout << "Tiled parallel " << parallel_time / 1000 << " ms, serial per pair " << serial_time / 1000 << " ms" << endl;
+	assert (max_error < 1e-3);
+	assert (left_right < left_left);
+	delete_crutchfield_frames(frames);
+	cout << " === end test crutchfield distances === " << endl;
+}
+
+/**
+ * Slides a window over a series of frames and compares the distances, kept up to date and
+ * calculated per pair, with the ones calculated from scratch over the frames in the last window.
+ */
+void test_crutchfield_window(int width = 8, int height = 6, int window_size = 20, int frame_count = 50) {
+	cout << " === start test crutchfield window === " << endl;
+	srand48(5678);
+	int p_size = width * height;
+	int bins = 8;
+	DataFrames frames = create_crutchfield_frames(width, height, frame_count);
+
+	Crutchfield sliding(bins, width, height);
+	sliding.setWindow(window_size);
+	dobots::Timer timer;
+	for (int t = 0; t < frame_count; ++t) {
+		sliding.addFrame(frames[t]);
+	}
+	long long sliding_time = timer.Elapsed();
+
+	DataFrames last(frames.end() - window_size, frames.end());
+	Crutchfield batch(bins, width, height);
+	batch.calcProbabilities(last);
+	batch.calcDistances();
+
+	Value max_error = 0;
+	for (int p0 = 0; p0 < p_size; ++p0) {
+		for (int p1 = 0; p1 < p_size; ++p1) {
+			max_error = std::max(max_error, std::fabs(sliding.getDistance(p0, p1) - batch.getDistance(p0, p1)));
+			max_error = std::max(max_error, std::fabs(sliding.calcDistance(p0, p1) - batch.getDistance(p0, p1)));
+		}
+	}
+	cout << "Maximum difference with calculation from scratch " << max_error << endl;
+	cout << "Sliding window " << sliding_time / frame_count << " us per frame" << endl;
+	assert (max_error < 1e-3);
+	delete_crutchfield_frames(frames);
+	cout << " === end test crutchfield window === " << endl;
+}
+
+/**
+ * Calculates the distances into a file, compares them with the ones in memory, and opens the
+ * file again to see that nothing needs to be calculated anymore.
+ */
+void test_mapped_distances(int width = 20, int height = 15, int frame_count = 50) {
+	cout << " === start test mapped distances === " << endl;
+	srand48(2468);
+	int p_size = width * height;
+	int bins = 8;
+	unsigned long long key = 2468;
+	std::string filename = "/tmp/test_mapped_distances.bin";
+	DataFrames frames = create_crutchfield_frames(width, height, frame_count);
+	Crutchfield crutchfield(bins, width, height);
+	crutchfield.calcProbabilities(frames);
+	crutchfield.calcDistances();
+
+	MappedDistanceMatrix matrix;
+	bool success = matrix.Open(filename, p_size, 32, key);
+	assert (success);
+	assert (matrix.getTilesDone() == 0);
+	crutchfield.calcDistances(matrix);
+	assert (matrix.getTilesDone() == matrix.getTilePairs());
+
+	Value max_error = 0;
+	for (int p0 = 0; p0 < p_size; ++p0) {
+		for (int p1 = 0; p1 < p_size; ++p1) {
+			max_error = std::max(max_error, std::fabs(matrix.getDistance(p0, p1) - crutchfield.getDistance(p0, p1)));
+		}
+	}
+	matrix.Close();
+	cout << "Maximum difference with distances in memory " << max_error << endl;
+	assert (max_error == 0);
+
+	// the same key, all tiles are reused
+	success = matrix.Open(filename, p_size, 32, key);
+	assert (success && matrix.getTilesDone() == matrix.getTilePairs());
+	assert (matrix.getDistance(3, 7) == crutchfield.getDistance(3, 7));
+	matrix.Close();
+
+	// another key, the file starts from scratch
+	success = matrix.Open(filename, p_size, 32, key + 1);
+	assert (success && matrix.getTilesDone() == 0);
+	matrix.Close();
+	unlink(filename.c_str());
+
+	delete_crutchfield_frames(frames);
+	cout << " === end test mapped distances === " << endl;
+}
@@ -28,6 +28,7 @@
 #include <Container.hpp>
 
 #include <cassert>
+#include <cstdlib>
 
 using namespace std;
 using namespace dobots;
@@ -121,6 +122,66 @@ void test_distance() {
 	set0.clear();
 	set1.clear();
 
+	// large random point clouds use a k-d tree, compare with brute force
+	int dim = 3;
+	for (int i = 0; i < 2000; ++i) {
+		TESTPOINT_DEF *q = new TESTPOINT_DEF(dim);
+		for (int d = 0; d < dim; ++d) (*q)[d] = drand48() * 100;
+		if (i % 4) set0.insert(q); else set1.insert(q);
+	}
+	DistanceMetric metrics[] = { DM_EUCLIDEAN, DM_MANHATTAN, DM_CHEBYSHEV };
+	for (int m = 0; m < 3; ++m) {
+		TESTVALUE brute = 0;
+		for (TESTSET_ITER i = set1.begin(); i != set1.end(); ++i) {
+			TESTVALUE nearest = -1;
+			for (TESTSET_ITER j = set0.begin(); j != set0.end(); ++j) {
+				TESTVALUE d = dobots::distance<TESTVALUE>((*i)->begin(), (*i)->end(), (*j)->begin(), (*j)->end(), metrics[m]);
+				if (nearest < 0 || d < nearest) nearest = d;
+			}
+			brute = std::max(brute, nearest);
+		}
+		TESTVALUE exact = dobots::distance_to_set<TESTVALUE, TESTSET_ITER, TESTPOINT_ITER>(set1.begin(), set1.end(),
+				set0.begin(), set0.end(), SDM_SUPINF, metrics[m]);
+		TESTVALUE approx = dobots::distance_to_set<TESTVALUE, TESTSET_ITER, TESTPOINT_ITER>(set1.begin(), set1.end(),
+				set0.begin(), set0.end(), SDM_SUPINF, metrics[m], 0.5);
+		cout << "SupInf of random clouds with metric " << metrics[m] << ": " << exact << " (tree) "
+				<< brute << " (brute force) " << approx << " (approximate)" << endl;
+		assert (exact == brute);
+		assert (approx >= brute && approx <= 1.5 * brute);
+	}
+	for (TESTSET_ITER i = set0.begin(); i != set0.end(); ++i) delete *i;
+	for (TESTSET_ITER i = set1.begin(); i != set1.end(); ++i) delete *i;
+	set0.clear();
+	set1.clear();
+
+	// two clusters at x = 0 and x = 10, the tree splits between them, a point at x = 5.5 is nearest to
+	// the second one, but the first one is within a factor 1.5, so the approximate search prunes the
+	// second cluster and the result is too large
+	for (int i = 0; i < 80; ++i) {
+		TESTPOINT_DEF *q = new TESTPOINT_DEF(dim);
+		(*q)[0] = (i < 40) ? 0 : 10;
+		for (int d = 1; d < dim; ++d) (*q)[d] = 0.4 + drand48() * 0.2;
+		set0.insert(q);
+	}
+	TESTPOINT_DEF *between = new TESTPOINT_DEF(dim);
+	(*between)[0] = 5.5;
+	for (int d = 1; d < dim; ++d) (*between)[d] = 0.5;
+	set1.insert(between);
+	for (int m = 0; m < 3; ++m) {
+		TESTVALUE exact = dobots::distance_to_set<TESTVALUE, TESTSET_ITER, TESTPOINT_ITER>(set1.begin(), set1.end(),
+				set0.begin(), set0.end(), SDM_SUPINF, metrics[m]);
+		TESTVALUE approx = dobots::distance_to_set<TESTVALUE, TESTSET_ITER, TESTPOINT_ITER>(set1.begin(), set1.end(),
+				set0.begin(), set0.end(), SDM_SUPINF, metrics[m], 0.5);
+		cout << "SupInf between clusters with metric " << metrics[m] << ": " << exact << " (exact) "
+				<< approx << " (approximate)" << endl;
+		assert (exact >= 4.5 && exact < 5);
+		assert (approx > exact && approx <= 1.5 * exact);
+	}
+	for (TESTSET_ITER i = set0.begin(); i != set0.end(); ++i) delete *i;
+	for (TESTSET_ITER i = set1.begin(); i != set1.end(); ++i) delete *i;
+	set0.clear();
+	set1.clear();
+
 	cout << " === end test distance metrics === " << endl;
 }
 
@@ -60,6 +60,10 @@ public:
 		}
 	}
 
+	void SetWeights(double weight) {
+		for (size_t i = 0; i < getParticles().size(); ++i) getParticles()[i]->setWeight(weight);
+	}
+
 	void Print() {
 		std::cout << "Particles (in order): ";
 		print(getParticles().begin(), getParticles().end());
@@ -73,6 +77,23 @@ public:
 		assert(false);
 	}
 
+	int StateDimension() { return 2; }
+
+	void StateVector(TestData & state, double *vector) {
+		vector[0] = state.fieldA;
+		vector[1] = state.fieldB;
+	}
+
+	//! Only particles with fieldA equal to 10 are expected to match
+	double LookAhead(TestData & state) {
+		return (state.fieldA == 10) ? 0.5 : 0.0;
+	}
+
+	void SetStateVector(TestData & state, const double *vector) {
+		state.fieldA = (int)std::floor(vector[0] + 0.5);
+		state.fieldB = (int)std::floor(vector[1] + 0.5);
+	}
+
 private:
 	int particle_count;
 };
@@ -82,6 +103,75 @@ void test_filter() {
 	TestParticleFilter filter;
 	filter.Init();
 	filter.Print();
+
+	// particles 1..10 with weights 1..10
+	ParticleEstimate estimate;
+	filter.GetEstimate(estimate);
+	std::cout << "Mean " << estimate.mean[0] << " (should be 7), variance " << estimate.getCovariance(0,0)
+			<< " (should be 6), MAP " << estimate.map[0] << " (should be 10), effective count "
+			<< estimate.effective_count << " (should be 7.857)" << std::endl;
+	assert (std::abs(estimate.mean[0] - 7) < 1e-9 && std::abs(estimate.mean[1] - 7) < 1e-9);
+	assert (std::abs(estimate.getCovariance(0,0) - 6) < 1e-9 && std::abs(estimate.getCovariance(0,1) - 6) < 1e-9);
+	assert (estimate.map[0] == 10 && estimate.map_weight == 10);
+	assert (std::abs(estimate.effective_count - 55.0 * 55.0 / 385.0) < 1e-9);
+	double median = filter.GetQuantile(0, 0.5);
+	std::cout << "Weighted median " << median << " (should be 7)" << std::endl;
+	assert (median == 7);
+	assert (filter.GetQuantile(1, 0) == 1 && filter.GetQuantile(1, 1) == 10);
+
 	filter.Resample();
 	filter.Print();
+
+	// KLD-sampling, ten particles in ten bins need many particles, in one bin only the minimum
+	KLDConfig kld;
+	kld.enabled = true;
+	kld.min_count = 5;
+	kld.max_count = 100;
+	TestParticleFilter spread;
+	spread.Init();
+	spread.SetKLDSampling(kld);
+	spread.Resample();
+	std::cout << "KLD-sampling over 10 bins gives " << spread.GetParticleCount() << " particles (should be 100)" << std::endl;
+	assert (spread.GetParticleCount() == 100);
+
+	kld.bin_size[0] = kld.bin_size[1] = 100;
+	TestParticleFilter concentrated;
+	concentrated.Init();
+	concentrated.SetKLDSampling(kld);
+	concentrated.Resample();
+	std::cout << "KLD-sampling over 1 bin gives " << concentrated.GetParticleCount() << " particles (should be 5)" << std::endl;
+	assert (concentrated.GetParticleCount() == 5);
+
+	// regularization, the two fields are equal in all particles, so the kernel only moves along
+	// that direction, and the copies of the same particle get apart
+	TestParticleFilter plain, regularized;
+	plain.Init();
+	plain.Resample();
+	ParticleEstimate before;
+	plain.GetEstimate(before);
+	regularized.SetSeed(1);
+	regularized.Init();
+	regularized.SetRegularization();
+	regularized.Resample();
+	regularized.Print();
+	ParticleEstimate after;
+	regularized.GetEstimate(after);
+	std::cout << "Regularized variance " << after.getCovariance(0,0) << " (should be above "
+			<< before.getCovariance(0,0) << " without regularization)" << std::endl;
+	assert (after.getCovariance(0,0) > before.getCovariance(0,0));
+	assert (after.getCovariance(0,0) == after.getCovariance(1,1) && after.getCovariance(0,0) == after.getCovariance(0,1));
+
+	// auxiliary particle filter, only the particle that looks ahead well is propagated, and its
+	// weight is divided by the look-ahead likelihood afterwards
+	TestParticleFilter auxiliary;
+	auxiliary.Init();
+	auxiliary.AuxiliarySelect();
+	ParticleEstimate selected;
+	auxiliary.GetEstimate(selected);
+	std::cout << "Auxiliary selection mean " << selected.mean[0] << " (should be 10)" << std::endl;
+	assert (auxiliary.GetParticleCount() == 10 && selected.mean[0] == 10 && selected.getCovariance(0,0) == 0);
+	auxiliary.SetWeights(0.25);
+	auxiliary.AuxiliaryCorrect();
+	auxiliary.GetEstimate(selected);
+	assert (std::abs(selected.map_weight - 0.5) < 1e-12);
 }
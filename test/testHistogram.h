@@ -25,16 +25,21 @@
 #include <Container.hpp>
 
 #include <iostream>
+#include <cassert>
+#include <cmath>
 
 using namespace std;
 
 void test_histogram() {
 	cout << " === start test histogram === " << endl;
 
+	std::vector<Value> per_pixel;
 	for (int i = 0; i < 2; ++i) {
 		int size = 10;
 		int bins = 4;
-		Histogram histogram(bins, size, 1);
+		// the same data per pixel and over all pixels, the results should be the same
+		HistogramMode mode = (i == 0) ? HM_PER_PIXEL : HM_GLOBAL;
+		Histogram histogram(bins, size, 1, mode);
 
 		DataFrames frames;
 		int nof_frames = 1;
@@ -51,11 +56,47 @@ void test_histogram() {
 		std::vector<Value> result;
 		histogram.getProbabilities(result);
 
-		cout << "Result: ";
+		cout << "Result (" << (mode == HM_GLOBAL ? "global" : "per pixel") << "): ";
 		for (int i = 0; i < result.size(); ++i) {
 			cout << result[i] << ' ';
 		}
 		cout << endl;
+
+		if (mode == HM_PER_PIXEL) {
+			per_pixel = result;
+		} else {
+			ASSERT_EQUAL(result.size(), per_pixel.size());
+			for (size_t b = 0; b < result.size(); ++b)
+				assert (std::abs(result[b] - per_pixel[b]) < 1e-6);
+		}
+	}
+
+	// colour histograms, two pixels (dark red and bright blue) in three planes
+	int size = 2;
+	int bins = 2;
+	DataValue rgb[] = { 100, 10,   10, 10,   10, 200 };
+	// joint: bins (0,0,0) and (0,0,1), the blue bin has stride 4, concatenated: per channel 2 bins
+	Value expected_joint[] = { 0.5, 0, 0, 0, 0.5, 0, 0, 0 };
+	Value expected_concatenated[] = { 2/6.0, 0, 2/6.0, 0, 1/6.0, 1/6.0 };
+	DataFrames frames;
+	frames.push_back(rgb);
+	for (int i = 0; i < 2; ++i) {
+		ChannelMode channel_mode = (i == 0) ? CM_JOINT : CM_CONCATENATED;
+		Histogram histogram(bins, size, 1, HM_GLOBAL);
+		histogram.setChannels(3, channel_mode);
+		histogram.calcProbabilities(frames);
+
+		std::vector<Value> result;
+		histogram.getProbabilities(result);
+		ASSERT_EQUAL(result.size(), (size_t)histogram.getHistogramSize());
+
+		const Value *expected = (channel_mode == CM_JOINT) ? expected_joint : expected_concatenated;
+		cout << "Result (" << (channel_mode == CM_JOINT ? "joint" : "concatenated") << "): ";
+		for (size_t b = 0; b < result.size(); ++b) {
+			cout << result[b] << ' ';
+			assert (std::abs(result[b] - expected[b]) < 1e-6);
+		}
+		cout << endl;
 	}
 	cout << " === end test histogram === " << endl;
 }
@@ -0,0 +1,124 @@
+/**
+ * @brief Benchmark of histogram accumulation
+ * @file testHistogramSpeed.h
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 8, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+#include <Histogram.h>
+#include <Timer.hpp>
+
+#include <iostream>
+#include <cstdlib>
+#include <cassert>
+
+using namespace std;
+
+/**
+ * Compares, on 640x480 frames, the straightforward way to count a histogram (value2bin and an
+ * increment per pixel, as calcProbabilities did before) with the per-pixel histogram and with
+ * the global histogram (four count tables), in grey-scale and in joint RGB. The frames have
+ * smooth gradients with a bit of noise, so neighbouring pixels often fall into the same bin,
+ * like in real images.
+ */
+void test_histogram_speed(int repeat = 20) {
+	cout << " === start test histogram speed === " << endl;
+	int width = 640, height = 480, p_size = width * height;
+	int bins = 16;
+
+	DataValue *data = new DataValue[p_size*3];
+	srand48(1234);
+	for (int c = 0; c < 3; ++c) {
+		for (int p = 0; p < p_size; ++p) {
+			int x = p % width, y = p / width;
+			data[c*p_size+p] = (DataValue)(((x + y*(c+1)) / 4 + (int)(drand48() * 8)) % 256);
+		}
+	}
+	DataFrames frames;
+	frames.push_back(data);
+
+	// reference
+	Histogram reference(bins, width, height);
+	dobots::Timer timer;
+	std::vector<HistogramValue> naive(bins, 0);
+	for (int r = 0; r < repeat; ++r) {
+		std::fill(naive.begin(), naive.end(), 0);
+		for (int p = 0; p < p_size; ++p) {
+			naive[reference.value2bin(data[p])]++;
+		}
+	}
+	long long naive_time = timer.Elapsed();
+
+	timer.Reset();
+	HistogramValues per_pixel;
+	for (int r = 0; r < repeat; ++r) {
+		Histogram histogram(bins, width, height, HM_PER_PIXEL);
+		histogram.calcProbabilities(frames);
+		histogram.getFrequencies(per_pixel);
+	}
+	long long per_pixel_time = timer.Elapsed();
+
+	timer.Reset();
+	HistogramValues global;
+	for (int r = 0; r < repeat; ++r) {
+		Histogram histogram(bins, width, height, HM_GLOBAL);
+		histogram.calcProbabilities(frames);
+		histogram.getFrequencies(global);
+	}
+	long long global_time = timer.Elapsed();
+
+	bool equal = (naive == per_pixel) && (naive == global);
+	cout << "Grey-scale, " << bins << " bins: naive " << naive_time / repeat << " us, per pixel "
+			<< per_pixel_time / repeat << " us, global " << global_time / repeat << " us per frame"
+			<< (equal ? "" : " (RESULTS DIFFER!)") << endl;
+	assert (equal);
+
+	// joint RGB, 8x8x8
+	bins = 8;
+	int size = bins*bins*bins;
+	timer.Reset();
+	naive.resize(size);
+	for (int r = 0; r < repeat; ++r) {
+		std::fill(naive.begin(), naive.end(), 0);
+		for (int p = 0; p < p_size; ++p) {
+			int b0 = (data[p] * bins) / 256;
+			int b1 = (data[p_size+p] * bins) / 256;
+			int b2 = (data[2*p_size+p] * bins) / 256;
+			naive[b0 + bins*b1 + bins*bins*b2]++;
+		}
+	}
+	naive_time = timer.Elapsed();
+
+	timer.Reset();
+	for (int r = 0; r < repeat; ++r) {
+		Histogram histogram(bins, width, height, HM_GLOBAL);
+		histogram.setChannels(3, CM_JOINT);
+		histogram.calcProbabilities(frames);
+		histogram.getFrequencies(global);
+	}
+	global_time = timer.Elapsed();
+
+	equal = (naive == global);
+	cout << "Joint RGB, " << size << " bins: naive " << naive_time / repeat << " us, global "
+			<< global_time / repeat << " us per frame" << (equal ? "" : " (RESULTS DIFFER!)") << endl;
+	assert (equal);
+
+	delete [] data;
+	cout << " === end test histogram speed === " << endl;
+}
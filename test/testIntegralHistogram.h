@@ -0,0 +1,90 @@
+/**
+ * @brief Test of histograms of rectangles from an integral histogram
+ * @file testIntegralHistogram.h
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 12, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+#include <Histogram.h>
+#include <IntegralHistogram.h>
+
+#include <iostream>
+#include <cstdlib>
+#include <cassert>
+#include <cmath>
+
+using namespace std;
+
+/**
+ * The histogram of a rectangle from the integral histogram should be the same as the one of
+ * Histogram over a copy of that rectangle, for one channel and for joint and concatenated colour.
+ */
+void test_integral_histogram() {
+	cout << " === start test integral histogram === " << endl;
+	int width = 40, height = 30, spectrum = 3;
+	std::vector<DataValue> image(width * height * spectrum);
+	srand48(5);
+	for (size_t i = 0; i < image.size(); ++i) image[i] = drand48() * 256;
+
+	int rectangles[][4] = { { 0, 0, 39, 29 }, { 5, 7, 20, 12 }, { 30, 20, 45, 35 }, { 10, 10, 10, 10 } };
+	for (int config = 0; config < 3; ++config) {
+		int channels = (config == 0) ? 1 : 3;
+		ChannelMode channel_mode = (config == 2) ? CM_CONCATENATED : CM_JOINT;
+		IntegralHistogram integral(4, channels, channel_mode);
+		integral.calcIntegral(&image[0], width, height, spectrum);
+
+		for (int r = 0; r < 4; ++r) {
+			int x0 = rectangles[r][0], y0 = rectangles[r][1];
+			int x1 = std::min(rectangles[r][2], width - 1), y1 = std::min(rectangles[r][3], height - 1);
+			int w = x1 - x0 + 1, h = y1 - y0 + 1;
+			std::vector<DataValue> crop(w * h * channels);
+			for (int c = 0; c < channels; ++c)
+				for (int y = 0; y < h; ++y)
+					for (int x = 0; x < w; ++x)
+						crop[(c * h + y) * w + x] = image[(c * height + y0 + y) * width + x0 + x];
+			DataFrames frames;
+			frames.push_back(&crop[0]);
+			Histogram histogram(4, w, h, HM_GLOBAL);
+			histogram.setChannels(channels, channel_mode);
+			histogram.calcProbabilities(frames);
+			NormalizedHistogramValues expected, result;
+			histogram.getProbabilities(expected);
+
+			integral.getProbabilities(rectangles[r][0], rectangles[r][1], rectangles[r][2], rectangles[r][3], result);
+			ASSERT_EQUAL(result.size(), expected.size());
+			for (size_t b = 0; b < result.size(); ++b)
+				assert (std::abs(result[b] - expected[b]) < 1e-6);
+		}
+		cout << "Integral histogram with " << channels << " channel(s)"
+				<< (channels > 1 ? (channel_mode == CM_JOINT ? " (joint)" : " (concatenated)") : "")
+				<< " equal to histograms of crops" << endl;
+	}
+
+	// a rectangle of more than 65535 pixels, in which a count of a bin passes 16 bits
+	int large_width = 320, large_height = 240;
+	std::vector<DataValue> large(large_width * large_height);
+	for (size_t i = 0; i < large.size(); ++i) large[i] = (i % 5) ? 10 : 200;
+	IntegralHistogram integral(4);
+	integral.calcIntegral(&large[0], large_width, large_height, 1);
+	NormalizedHistogramValues result;
+	integral.getProbabilities(0, 0, large_width - 1, large_height - 1, result);
+	assert (std::abs(result[0] - 0.8) < 1e-6 && std::abs(result[3] - 0.2) < 1e-6);
+	cout << "Integral histogram of all " << large.size() << " pixels correct" << endl;
+	cout << " === end test integral histogram === " << endl;
+}
@@ -0,0 +1,133 @@
+/**
+ * @brief
+ * @file testIpcamStream.h
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 2, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+
+#ifndef TESTIPCAMSTREAM_H_
+#define TESTIPCAMSTREAM_H_
+
+#include <CImg.h>
+#include <IpcamImageSource.h>
+#include <MjpegServer.h>
+#include <Timer.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib> // getenv
+#include <vector>
+#include <pthread.h>
+#include <unistd.h> // sysconf
+
+using namespace std;
+using namespace cimg_library;
+
+//! Keeps a core busy till the flag it gets is set
+static void *burn_cpu(void *stop) {
+	volatile double x = 1;
+	while (!*(volatile bool*)stop) x = x * 1.0000001 + 1e-9;
+	return NULL;
+}
+
+/**
+ * Streams frame_count frames from a new server and collects the latency of each of them. The
+ * received images are paired with the sent ones by the frame number in their header, so a
+ * dropped or repeated item does not shift all latencies after it.
+ */
+static bool stream_latencies(MjpegServer & server, int frame_count, vector<long long> & latencies,
+		long long & elapsed) {
+	if (!server.Start()) {
+		cerr << "Could not start MJPEG server" << endl;
+		return false;
+	}
+	IpcamImageSource<CImg<DataValue> > source;
+	source.SetServer("127.0.0.1", server.GetPort());
+	source.SetPath("/tmp");
+	source.SetBasename("ipcam_stream_");
+	source.SetWaitPerPackage(0);
+	source.Update();
+
+	latencies.clear();
+	dobots::Timer timer;
+	long previous = -1;
+	for (int i = 0; i < frame_count; ++i) {
+		CImg<DataValue> *img = source.getImage();
+		long long received = dobots::get_time_us();
+		long number = source.GetFrameNumber();
+		assert (number > previous);
+		previous = number;
+		latencies.push_back(received - server.GetSendTime(number));
+		delete img;
+	}
+	elapsed = timer.Elapsed();
+	server.Stop();
+	sort(latencies.begin(), latencies.end());
+	return true;
+}
+
+/**
+ * Replays recorded frames (for example obtained with create_images) over a loopback MJPEG
+ * server and measures how fast and with which latency IpcamImageSource receives them. The
+ * latency is the time between the server starting to send a frame and getImage returning
+ * it, so it includes writing and decoding the image file. It is measured on an idle machine
+ * and with a busy thread on every core.
+ */
+void test_ipcam_stream(float frames_per_second = 25, int jitter_us = 5000, int frame_count = 100) {
+	cout << " === start test ipcam stream === " << endl;
+
+	string home = string(getenv("HOME"));
+	string path = home + "/mydata/dotty";
+
+	int cores = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+	for (int loaded = 0; loaded < 2; ++loaded) {
+		MjpegServer server;
+		if (!server.LoadFrames(path, ".jpg")) {
+			cerr << "No recorded frames in " << path << endl;
+			return;
+		}
+		server.SetFrameRate(frames_per_second);
+		server.SetJitter(jitter_us);
+		server.SetFragmentation(100, CHUNKSIZE, 50);
+
+		volatile bool stop = false;
+		vector<pthread_t> load(loaded ? cores : 0);
+		for (size_t i = 0; i < load.size(); ++i)
+			pthread_create(&load[i], NULL, burn_cpu, (void*)&stop);
+
+		vector<long long> latencies;
+		long long elapsed;
+		bool success = stream_latencies(server, frame_count, latencies, elapsed);
+		stop = true;
+		for (size_t i = 0; i < load.size(); ++i)
+			pthread_join(load[i], NULL);
+		if (!success) return;
+
+		cout << "Stream at " << frames_per_second << " fps" << (loaded ? " with a busy thread per core" : "") << endl;
+		cout << "Received " << frame_count << " frames in " << elapsed / 1000 << " ms (";
+		cout << frame_count * 1000000.0 / elapsed << " fps, server sent " << frames_per_second << " fps)" << endl;
+		cout << "Latency [us] min=" << latencies.front() << " median=" << latencies[frame_count/2];
+		cout << " p95=" << latencies[frame_count*95/100] << " max=" << latencies.back() << endl;
+	}
+
+	cout << " === end test ipcam stream === " << endl;
+}
+
+#endif /* TESTIPCAMSTREAM_H_ */
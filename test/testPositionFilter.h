@@ -0,0 +1,228 @@
+/**
+ * @brief Tests of the position particle filter on synthetic images
+ * @file testPositionFilter.h
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory
+ * farming, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 18, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+#include <PositionParticleFilter.h>
+#include <MultiTargetTracker.h>
+#include <ThreadPool.h>
+#include <Timer.hpp>
+
+#include <iostream>
+#include <cstdlib>
+#include <cassert>
+#include <cmath>
+
+using namespace std;
+
+/**
+ * A grey noisy background with a red square of the given size centred at [x,y]. The background is
+ * the same every time.
+ */
+static void draw_target(CImg<DataValue> & img, int x, int y, int size) {
+	srand48(1);
+	for (unsigned long i = 0; i < img.size(); ++i) img._data[i] = 60 + drand48() * 60;
+	const DataValue red[] = { 250, 10, 10 };
+	img.draw_rectangle(x - size/2, y - size/2, x + size/2 - 1, y + size/2 - 1, red);
+}
+
+//! As draw_target, with a blue square of the same size centred at [x2,y2] as well
+static void draw_targets(CImg<DataValue> & img, int x, int y, int x2, int y2, int size) {
+	draw_target(img, x, y, size);
+	const DataValue blue[] = { 10, 10, 250 };
+	img.draw_rectangle(x2 - size/2, y2 - size/2, x2 + size/2 - 1, y2 + size/2 - 1, blue);
+}
+
+//! A filter with 8x8x8 joint colour bins for the square of draw_target
+static void init_filter(PositionParticleFilter & filter, CImg<DataValue> & img, int x, int y, int size,
+		int particle_count) {
+	filter.SetHistogramConfig(8, 3, CM_JOINT);
+	CImg<DataValue> target = img.get_crop(x - size/2, y - size/2, x + size/2 - 1, y + size/2 - 1);
+	NormalizedHistogramValues histogram;
+	filter.CalcHistogram(target, histogram);
+	CImg<CoordValue> coord(6);
+	coord(0) = x - size/2; coord(1) = y - size/2; coord(3) = x + size/2; coord(4) = y + size/2;
+	filter.Init(histogram, coord, particle_count);
+	filter.SetImage(&img);
+}
+
+/**
+ * The coarse-to-fine scan finds the square, and gives the same map in this thread as on a pool, also
+ * with a task per refined cell.
+ */
+void test_scan_likelihoods() {
+	cout << " === start test scan likelihoods === " << endl;
+	int size = 24;
+	CImg<DataValue> img(320, 240, 1, 3);
+	draw_target(img, 200, 88, size);
+	PositionParticleFilter filter;
+	init_filter(filter, img, 200, 88, size, 5);
+
+	RegionSize region_size;
+	region_size.width = region_size.height = size;
+	ScanConfig config;
+	CImg<float> map;
+	int best_x, best_y;
+	float best = filter.ScanLikelihoods(map, region_size, config, best_x, best_y);
+	cout << "Best " << best << " at [" << best_x << ',' << best_y << "] (should be [200,88])" << endl;
+	assert (best_x == 200 && best_y == 88);
+
+	ThreadPool pool(2);
+	config.pool = &pool;
+	for (int i = 0; i < 2; ++i) {
+		// with small tiles every refined cell gets its own task
+		config.tile_size = (i == 0) ? 128 : 16;
+		CImg<float> pool_map;
+		int pool_x, pool_y;
+		float pool_best = filter.ScanLikelihoods(pool_map, region_size, config, pool_x, pool_y);
+		assert (pool_best == best && pool_x == best_x && pool_y == best_y);
+		assert (pool_map.size() == map.size());
+		for (unsigned long j = 0; j < map.size(); ++j)
+			assert (pool_map._data[j] == map._data[j]);
+		cout << "Same map on a pool with tiles of " << config.tile_size << " pixels" << endl;
+	}
+	cout << " === end test scan likelihoods === " << endl;
+}
+
+/**
+ * The square jumps to the other side of the image. The particles lose it, the track is detected to be
+ * lost, and they are put on the square again within the time budget of the search.
+ */
+void test_redetection() {
+	cout << " === start test redetection === " << endl;
+	int size = 24;
+	CImg<DataValue> img(320, 240, 1, 3);
+	draw_target(img, 200, 88, size);
+	PositionParticleFilter filter;
+	init_filter(filter, img, 200, 88, size, 50);
+	RedetectConfig redetect;
+	redetect.enabled = true;
+	redetect.time_budget = 50000;
+	filter.SetRedetection(redetect);
+
+	draw_target(img, 80, 160, size);
+	dobots::Timer timer;
+	filter.Tick(&img);
+	long long elapsed = timer.Elapsed();
+	ParticleEstimate estimate;
+	filter.GetEstimate(estimate);
+	cout << "Lost " << filter.GetLostCount() << " times, reseeded " << filter.GetReseedCount()
+			<< " times, estimate [" << estimate.mean[0] << ',' << estimate.mean[1] << "] (should be [80,160]) in "
+			<< elapsed << " us" << endl;
+	assert (filter.GetLostCount() == 1 && filter.GetReseedCount() == 1);
+	assert (fabs(estimate.mean[0] - 80) <= redetect.scan.fine_step);
+	assert (fabs(estimate.mean[1] - 160) <= redetect.scan.fine_step);
+	// the search keeps to the budget, the rest of the tick is small in comparison
+	assert (elapsed < 2 * redetect.time_budget);
+	cout << " === end test redetection === " << endl;
+}
+
+/**
+ * A red and a blue square move towards each other, tracked together on a pool with the likelihoods
+ * of every target spread over several tasks. Every estimate follows its own square.
+ */
+void test_multi_target_tracker() {
+	cout << " === start test multi target tracker === " << endl;
+	int size = 24, x = 80, y = 100, x2 = 240, y2 = 140, step = 2;
+	CImg<DataValue> img(320, 240, 1, 3);
+	draw_targets(img, x, y, x2, y2, size);
+
+	ThreadPool pool(4);
+	MultiTargetTracker tracker(pool, 16);
+	tracker.SetHistogramConfig(8, 3, CM_JOINT);
+	int target[2][2] = { { x, y }, { x2, y2 } };
+	for (int t = 0; t < 2; ++t) {
+		int tx = target[t][0], ty = target[t][1];
+		CImg<DataValue> crop = img.get_crop(tx - size/2, ty - size/2, tx + size/2 - 1, ty + size/2 - 1);
+		NormalizedHistogramValues histogram;
+		tracker.CalcHistogram(crop, histogram);
+		CImg<CoordValue> coord(6);
+		coord(0) = tx - size/2; coord(1) = ty - size/2; coord(3) = tx + size/2; coord(4) = ty + size/2;
+		assert (tracker.AddTarget(histogram, coord, 50) == t);
+	}
+
+	for (int frame = 0; frame < 20; ++frame) {
+		x += step;
+		x2 -= step;
+		draw_targets(img, x, y, x2, y2, size);
+		tracker.Tick(&img, 4);
+		int position[2][2] = { { x, y }, { x2, y2 } };
+		for (int t = 0; t < 2; ++t) {
+			ParticleEstimate estimate;
+			tracker.GetTarget(t)->GetEstimate(estimate);
+			cout << "Target " << t << " at [" << estimate.mean[0] << ',' << estimate.mean[1]
+					<< "] (should be [" << position[t][0] << ',' << position[t][1] << "])" << endl;
+			assert (fabs(estimate.mean[0] - position[t][0]) < size / 4);
+			assert (fabs(estimate.mean[1] - position[t][1]) < size / 4);
+		}
+	}
+	cout << " === end test multi target tracker === " << endl;
+}
+
+/**
+ * The square grows to three times its size. With an integral histogram the ring around the rectangles
+ * keeps the particles from staying small within the square, so the scale follows it.
+ */
+void test_scale_estimation() {
+	cout << " === start test scale estimation === " << endl;
+	int size = 24, x = 160, y = 120;
+	CImg<DataValue> img(320, 240, 1, 3);
+	draw_target(img, x, y, size);
+	PositionParticleFilter filter;
+	init_filter(filter, img, x, y, size, 200);
+	filter.SetScaleModel(0.03);
+	IntegralHistogram integral(8, 3, CM_JOINT);
+	filter.SetIntegralHistogram(&integral);
+
+	double scale = 1;
+	for (int frame = 1; frame <= 24; ++frame) {
+		int grown = size + 2 * frame;
+		draw_target(img, x, y, grown);
+		integral.calcIntegral(img._data, img._width, img._height, img._spectrum);
+		filter.Tick(&img);
+		scale = filter.GetQuantile(2, 0.5);
+		if (frame % 8 == 0)
+			cout << "Median scale " << scale << " (should be " << (double)grown / size << ")" << endl;
+	}
+	assert (fabs(scale - 3) < 0.3);
+	cout << " === end test scale estimation === " << endl;
+}
+
+/**
+ * Without an integral histogram the ring around the rectangles is not compared, so nothing would hold
+ * the scale. A static square keeps its size.
+ */
+void test_fixed_scale() {
+	cout << " === start test fixed scale === " << endl;
+	int size = 40, x = 160, y = 120;
+	CImg<DataValue> img(320, 240, 1, 3);
+	draw_target(img, x, y, size);
+	PositionParticleFilter filter;
+	init_filter(filter, img, x, y, size, 100);
+	assert (!filter.IsScaleLive());
+
+	for (int frame = 0; frame < 100; ++frame)
+		filter.Tick(&img);
+	double scale = filter.GetQuantile(2, 0.5);
+	cout << "Median scale " << scale << " (should be 1)" << endl;
+	assert (fabs(scale - 1) < 0.05);
+	cout << " === end test fixed scale === " << endl;
+}
@@ -0,0 +1,66 @@
+/**
+ * @brief 
+ * @file testRaoBlackwellized.h
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common 
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from 
+ * thread pools and TCP/IP components to control architectures and learning algorithms. 
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object to this software being used by the military, in factory 
+ * farming, for animal experimentation, or anything that violates the Universal 
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2012 Anne van Rossum <anne@almende.com>
+ *
+ * @author  Anne C. van Rossum
+ * @date    Oct 18, 2012
+ * @project Replicator FP7
+ * @company Almende B.V.
+ * @case    modular robotics / sensor fusion
+ */
+
+#include <RaoBlackwellizedParticleFilter.hpp>
+
+#include <iostream>
+#include <cassert>
+#include <cmath>
+
+/**
+ * An object that moves with constant velocity over a plane, observed with Gaussian noise.
+ */
+class TestRaoBlackwellized: public RaoBlackwellizedParticleFilter<2> {
+public:
+	void Observe(double x, double y) {
+		observed[0] = x;
+		observed[1] = y;
+	}
+
+protected:
+	double Likelihood(const double *values) {
+		double dx = values[0] - observed[0], dy = values[1] - observed[1];
+		return std::exp(-(dx * dx + dy * dy) / (2 * 4.0));
+	}
+
+private:
+	double observed[2];
+};
+
+void test_rao_blackwellized() {
+	std::cout << " === start test rao-blackwellized === " << std::endl;
+	TestRaoBlackwellized filter;
+	double start[] = { 0, 0 };
+	filter.Init(start, 50, 25.0);
+	double position[2], velocity[2];
+	for (int n = 1; n <= 40; ++n) {
+		filter.Observe(3.0 * n, -2.0 * n);
+		filter.Tick();
+	}
+	filter.GetEstimate(position, velocity);
+	std::cout << "Position [" << position[0] << ',' << position[1] << "] (should be about [120,-80]), velocity ["
+			<< velocity[0] << ',' << velocity[1] << "] (should be about [3,-2])" << std::endl;
+	assert (std::abs(position[0] - 120) < 3 && std::abs(position[1] + 80) < 3);
+	assert (std::abs(velocity[0] - 3) < 0.5 && std::abs(velocity[1] + 2) < 0.5);
+	std::cout << " === end test rao-blackwellized === " << std::endl;
+}